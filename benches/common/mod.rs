@@ -0,0 +1,30 @@
+//! Shared by the benchmarks.
+
+use mecab_wrapper::{global_error_str, Model};
+
+/// Model from `MECAB_ARGS`, or `None` (with a message) if it cannot be created.
+pub fn model() -> Option<Model> {
+    let args = std::env::var("MECAB_ARGS").unwrap_or_default();
+    let model = Model::new(args);
+    if model.is_none() {
+        eprintln!("null model: {}", global_error_str().unwrap());
+    }
+    model
+}
+
+/// Text of `MECAB_BENCH_CORPUS`, one sentence per line, or a synthetic corpus of `lines` lines.
+pub fn corpus(lines: usize) -> String {
+    if let Ok(path) = std::env::var("MECAB_BENCH_CORPUS") {
+        return std::fs::read_to_string(path).expect("cannot read MECAB_BENCH_CORPUS");
+    }
+    let sentences = [
+        "すもももももももものうち",
+        "東京都に住んでいます。",
+        "今日はとても良い天気ですね。",
+        "メカブは日本語の形態素解析器です。",
+    ];
+    (0..lines)
+        .map(|i| sentences[i % sentences.len()])
+        .collect::<Vec<_>>()
+        .join("\n")
+}
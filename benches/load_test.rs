@@ -0,0 +1,421 @@
+//! End-to-end load test: replays a corpus through the tagger patterns of the crate docs at each
+//! concurrency level, and reports throughput, latency percentiles, RSS and allocations per
+//! sentence.
+//!
+//! ```sh
+//! MECAB_ARGS="-d /path/to/dic" MECAB_BENCH_CORPUS=corpus.txt cargo bench --bench load_test
+//! ```
+//!
+//! The patterns are:
+//!
+//! - `shared`: one [`Tagger`] shared by all the threads, with lattices from a [`LatticePool`];
+//! - `per-thread`: a tagger and a lattice created by each thread;
+//! - `async`: an [`AsyncTagger`] with one worker per thread, with 4 requests in flight per
+//!   worker.
+//!
+//! Each thread (or in-flight request) takes the next sentence of the corpus until all of them
+//! are parsed. `latency` is the time of one sentence as seen by the caller; every sample is kept,
+//! so its percentiles are exact. `parse` is the time MeCab spends in [`Tagger::parse()`] (per
+//! sentence) or [`Tagger::parse_batch()`] (per batch, for `async`), recorded through
+//! [`set_metrics_sink()`] into a [`HistogramSink`], whose percentiles are within 1/16. The
+//! lattice metrics of [`set_lattice_stats()`](mecab_wrapper::set_lattice_stats()) are left
+//! disabled, so that the shared and per-thread patterns do not pay for an extra pass over each
+//! lattice that the async one skips.
+//! Allocations are counted by a global allocator, so they do not include the ones of MeCab in
+//! C++.
+//!
+//! Environment variables:
+//!
+//! - `MECAB_LOAD_THREADS`: comma-separated concurrency levels (default: powers of two up to the
+//!   number of cores);
+//! - `MECAB_LOAD_OUT`: output directory (default: `target/load-test`);
+//! - `MECAB_LOAD_TAG`: name of the results, e.g. a commit (default: `git rev-parse --short
+//!   HEAD`);
+//! - `MECAB_LOAD_PERF`: if set, each run is recorded by `perf record -g` into
+//!   `$MECAB_LOAD_OUT/$MECAB_LOAD_TAG-<pattern>-<threads>.perf.data`, ready for
+//!   `perf script | inferno-collapse-perf | inferno-flamegraph`.
+//!
+//! The results are printed and written as TSV to `$MECAB_LOAD_OUT/$MECAB_LOAD_TAG.tsv`, so that
+//! runs of two commits can be compared.
+
+mod common;
+
+use mecab_wrapper::{
+    set_metrics_sink, AsyncOptions, AsyncTagger, Histogram, HistogramSink, Lattice, LatticePool,
+    Metric, MetricsSink, Model, Tagger,
+};
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::fmt::Write as _;
+use std::path::{Path, PathBuf};
+use std::process::{Child, Command};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+/// Counts the (re)allocations of the Rust side.
+struct CountingAlloc;
+
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+/// Requests in flight per worker of the `async` pattern.
+const ASYNC_CLIENTS_PER_WORKER: usize = 4;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Pattern {
+    Shared,
+    PerThread,
+    Async,
+}
+
+impl Pattern {
+    const ALL: [Pattern; 3] = [Pattern::Shared, Pattern::PerThread, Pattern::Async];
+
+    fn name(self) -> &'static str {
+        match self {
+            Pattern::Shared => "shared",
+            Pattern::PerThread => "per-thread",
+            Pattern::Async => "async",
+        }
+    }
+
+    fn parse_metric(self) -> Metric {
+        match self {
+            Pattern::Async => Metric::ParseBatch,
+            _ => Metric::Parse,
+        }
+    }
+}
+
+struct Run {
+    pattern: Pattern,
+    threads: usize,
+    sentences: usize,
+    tokens: usize,
+    elapsed: Duration,
+    allocations: u64,
+    /// Latency of each sentence in nanoseconds, sorted.
+    latency: Vec<u64>,
+    parse: Histogram,
+    /// `VmRSS` and `VmHWM` of `/proc/self/status` after the run, in bytes.
+    rss: u64,
+    peak_rss: u64,
+}
+
+/// Replays `sentences` in one thread per element of `latencies`, each taking the next sentence
+/// until none is left and pushing its latency in nanoseconds to its element. Each thread creates
+/// its state with `init` and parses a sentence with `parse`, which returns the number of tokens.
+fn replay<S>(
+    sentences: &[&str],
+    latencies: &mut [Vec<u64>],
+    init: impl Fn() -> S + Sync,
+    parse: impl Fn(&mut S, &str) -> usize + Sync,
+) -> usize {
+    let next = AtomicUsize::new(0);
+    let (next, init, parse) = (&next, &init, &parse);
+    std::thread::scope(|s| {
+        let workers: Vec<_> = latencies
+            .iter_mut()
+            .map(|latencies| {
+                s.spawn(move || {
+                    let mut state = init();
+                    let mut tokens = 0;
+                    while let Some(sentence) = sentences.get(next.fetch_add(1, Ordering::Relaxed)) {
+                        let start = Instant::now();
+                        tokens += parse(&mut state, sentence);
+                        latencies.push(start.elapsed().as_nanos() as u64);
+                    }
+                    tokens
+                })
+            })
+            .collect();
+        workers.into_iter().map(|w| w.join().unwrap()).sum()
+    })
+}
+
+fn run_shared(model: &Model, sentences: &[&str], latencies: &mut [Vec<u64>]) -> usize {
+    let tagger = model.create_tagger().unwrap();
+    let pool: LatticePool<'_> = model.pool(latencies.len());
+    pool.warm_up(&tagger, sentences[0]);
+
+    let parse = |_: &mut (), sentence: &str| {
+        let mut lattice = pool.get();
+        lattice.set_sentence(sentence);
+        assert!(tagger.parse(&mut lattice));
+        lattice.best_tokens().count()
+    };
+    replay(sentences, latencies, || (), parse)
+}
+
+fn run_per_thread(model: &Model, sentences: &[&str], latencies: &mut [Vec<u64>]) -> usize {
+    let init = || {
+        let tagger: Tagger<'_> = model.create_tagger().unwrap();
+        (tagger, model.create_lattice())
+    };
+    let parse = |(tagger, lattice): &mut (Tagger<'_>, Lattice<'_>), sentence: &str| {
+        lattice.set_sentence(sentence);
+        assert!(tagger.parse(lattice));
+        lattice.best_tokens().count()
+    };
+    replay(sentences, latencies, init, parse)
+}
+
+/// Sends the next sentence to `tagger` and waits for it, until none is left.
+async fn client(
+    tagger: &AsyncTagger,
+    sentences: &[&str],
+    next: &AtomicUsize,
+    latencies: &mut Vec<u64>,
+) -> usize {
+    let mut tokens = 0;
+    while let Some(sentence) = sentences.get(next.fetch_add(1, Ordering::Relaxed)) {
+        let start = Instant::now();
+        tokens += tagger.parse(*sentence).await.unwrap().tokens().len();
+        latencies.push(start.elapsed().as_nanos() as u64);
+    }
+    tokens
+}
+
+/// Parses `sentences` with `threads` workers and one client per element of `latencies`.
+fn run_async(
+    model: &Arc<Model>,
+    threads: usize,
+    sentences: &[&str],
+    latencies: &mut [Vec<u64>],
+) -> usize {
+    use futures::stream::{FuturesUnordered, StreamExt};
+
+    let tagger = AsyncTagger::new(Arc::clone(model), AsyncOptions::new(threads)).unwrap();
+    let next = AtomicUsize::new(0);
+    let clients: FuturesUnordered<_> = latencies
+        .iter_mut()
+        .map(|latencies| client(&tagger, sentences, &next, latencies))
+        .collect();
+    futures::executor::block_on(clients.fold(0, |sum, tokens| async move { sum + tokens }))
+}
+
+/// `VmRSS` and `VmHWM` of this process in bytes.
+fn rss() -> (u64, u64) {
+    let status = std::fs::read_to_string("/proc/self/status").unwrap_or_default();
+    let field = |name: &str| {
+        status
+            .lines()
+            .find_map(|l| l.strip_prefix(name))
+            .and_then(|v| v.trim().trim_end_matches("kB").trim().parse::<u64>().ok())
+            .map_or(0, |kb| kb << 10)
+    };
+    (field("VmRSS:"), field("VmHWM:"))
+}
+
+/// Resets `VmHWM` to the current RSS, so that the peak is measured per run. It is best-effort:
+/// the kernel may not support it.
+fn reset_peak_rss() {
+    let _ = std::fs::write("/proc/self/clear_refs", "5");
+}
+
+/// Starts `perf record` on this process if `MECAB_LOAD_PERF` is set.
+fn start_perf(out: &Path) -> Option<Child> {
+    std::env::var_os("MECAB_LOAD_PERF")?;
+    let pid = std::process::id().to_string();
+    let child = Command::new("perf")
+        .args(["record", "-F", "999", "-g", "-p", &pid, "-o"])
+        .arg(out)
+        .spawn();
+    match child {
+        Ok(child) => {
+            // Let perf attach before the run starts.
+            std::thread::sleep(Duration::from_millis(200));
+            Some(child)
+        }
+        Err(e) => {
+            eprintln!("cannot run perf: {e}");
+            None
+        }
+    }
+}
+
+fn stop_perf(child: Option<Child>) {
+    if let Some(mut child) = child {
+        // perf writes its data on SIGINT.
+        unsafe {
+            libc::kill(child.id() as libc::pid_t, libc::SIGINT);
+        }
+        let _ = child.wait();
+    }
+}
+
+fn run(
+    model: &Arc<Model>,
+    pattern: Pattern,
+    threads: usize,
+    sentences: &[&str],
+    metrics: &HistogramSink,
+    perf: &Path,
+) -> Run {
+    // Allocated before counting, with room for every sentence so that no push reallocates.
+    let clients = match pattern {
+        Pattern::Async => threads * ASYNC_CLIENTS_PER_WORKER,
+        _ => threads,
+    };
+    let mut latencies: Vec<Vec<u64>> = (0..clients)
+        .map(|_| Vec::with_capacity(sentences.len()))
+        .collect();
+    metrics.reset();
+    reset_peak_rss();
+    let perf = start_perf(perf);
+
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed);
+    let start = Instant::now();
+    let tokens = match pattern {
+        Pattern::Shared => run_shared(model, sentences, &mut latencies),
+        Pattern::PerThread => run_per_thread(model, sentences, &mut latencies),
+        Pattern::Async => run_async(model, threads, sentences, &mut latencies),
+    };
+    let elapsed = start.elapsed();
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - allocations;
+
+    stop_perf(perf);
+    let (rss, peak_rss) = rss();
+    Run {
+        pattern,
+        threads,
+        sentences: sentences.len(),
+        tokens,
+        elapsed,
+        allocations,
+        latency: {
+            let mut latency = latencies.concat();
+            latency.sort_unstable();
+            latency
+        },
+        parse: metrics.histogram(pattern.parse_metric()),
+        rss,
+        peak_rss,
+    }
+}
+
+fn thread_counts() -> Vec<usize> {
+    if let Ok(threads) = std::env::var("MECAB_LOAD_THREADS") {
+        return threads
+            .split(',')
+            .map(|t| t.trim().parse().expect("invalid MECAB_LOAD_THREADS"))
+            .collect();
+    }
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    std::iter::successors(Some(1), |t| Some(t * 2))
+        .take_while(|&t| t <= cores)
+        .collect()
+}
+
+fn tag() -> String {
+    if let Ok(tag) = std::env::var("MECAB_LOAD_TAG") {
+        return tag;
+    }
+    Command::new("git")
+        .args(["rev-parse", "--short", "HEAD"])
+        .output()
+        .ok()
+        .filter(|o| o.status.success())
+        .and_then(|o| String::from_utf8(o.stdout).ok())
+        .map_or_else(|| "untagged".to_string(), |s| s.trim().to_string())
+}
+
+const HEADER: &str = "pattern\tthreads\tsentences_per_s\ttokens_per_s\tlatency_p50_us\t\
+                      latency_p99_us\tlatency_p999_us\tparse_p50_us\tparse_p99_us\tparse_p999_us\t\
+                      rss_mb\tpeak_rss_mb\tallocs_per_sentence";
+
+/// Exact `q`-quantile of the sorted `values`.
+fn quantile(values: &[u64], q: f64) -> u64 {
+    if values.is_empty() {
+        return 0;
+    }
+    let rank = (values.len() as f64 * q).ceil() as usize;
+    values[rank.clamp(1, values.len()) - 1]
+}
+
+fn row(r: &Run) -> String {
+    let secs = r.elapsed.as_secs_f64();
+    let us = |h: &Histogram, q: f64| h.percentile(q) as f64 / 1e3;
+    let latency_us = |q: f64| quantile(&r.latency, q) as f64 / 1e3;
+    let mb = |b: u64| b as f64 / (1 << 20) as f64;
+    format!(
+        "{}\t{}\t{:.0}\t{:.0}\t{:.1}\t{:.1}\t{:.1}\t{:.1}\t{:.1}\t{:.1}\t{:.1}\t{:.1}\t{:.2}",
+        r.pattern.name(),
+        r.threads,
+        r.sentences as f64 / secs,
+        r.tokens as f64 / secs,
+        latency_us(0.5),
+        latency_us(0.99),
+        latency_us(0.999),
+        us(&r.parse, 0.5),
+        us(&r.parse, 0.99),
+        us(&r.parse, 0.999),
+        mb(r.rss),
+        mb(r.peak_rss),
+        r.allocations as f64 / r.sentences as f64,
+    )
+}
+
+fn main() {
+    let model = if let Some(model) = common::model() {
+        Arc::new(model)
+    } else {
+        return;
+    };
+
+    let corpus = common::corpus(50_000);
+    let sentences: Vec<&str> = corpus.lines().filter(|l| !l.is_empty()).collect();
+    assert!(!sentences.is_empty(), "empty corpus");
+
+    let metrics = Arc::new(HistogramSink::new());
+    set_metrics_sink(Arc::clone(&metrics) as Arc<dyn MetricsSink>);
+
+    let out = PathBuf::from(
+        std::env::var("MECAB_LOAD_OUT").unwrap_or_else(|_| "target/load-test".to_string()),
+    );
+    std::fs::create_dir_all(&out).expect("cannot create MECAB_LOAD_OUT");
+    let tag = tag();
+
+    let mut tsv = String::new();
+    writeln!(tsv, "{HEADER}").unwrap();
+    println!("{HEADER}");
+    for threads in thread_counts() {
+        for pattern in Pattern::ALL {
+            let perf = out.join(format!("{tag}-{}-{threads}.perf.data", pattern.name()));
+            let run = run(&model, pattern, threads, &sentences, &metrics, &perf);
+            let row = row(&run);
+            println!("{row}");
+            writeln!(tsv, "{row}").unwrap();
+        }
+    }
+    if let Ok(memory) = model.resident_memory() {
+        println!(
+            "dictionary pages: rss {:.1} MB, pss {:.1} MB",
+            memory.rss as f64 / (1 << 20) as f64,
+            memory.pss as f64 / (1 << 20) as f64,
+        );
+    }
+
+    let path = out.join(format!("{tag}.tsv"));
+    std::fs::write(&path, tsv).expect("cannot write the results");
+    println!("results: {}", path.display());
+}
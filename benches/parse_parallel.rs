@@ -0,0 +1,48 @@
+//! Throughput of `Model::parse_parallel()` by the number of threads.
+//!
+//! ```sh
+//! MECAB_ARGS="-d /path/to/dic" MECAB_BENCH_CORPUS=corpus.txt cargo bench --bench parse_parallel
+//! ```
+//!
+//! `MECAB_BENCH_CORPUS` is a text file with one sentence per line. Without it, a synthetic corpus
+//! is used.
+
+mod common;
+
+use mecab_wrapper::{OutputOrder, ParallelOptions};
+
+use std::time::Instant;
+
+fn main() {
+    let model = if let Some(model) = common::model() {
+        model
+    } else {
+        return;
+    };
+
+    let corpus = common::corpus(50_000);
+    let sentences = corpus.lines().count();
+    let bytes = corpus.len();
+
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let mut threads = 1;
+    while threads <= cores {
+        for order in [OutputOrder::Input, OutputOrder::Unordered] {
+            let options = ParallelOptions::new(threads).order(order);
+            let mut tokens = 0;
+
+            let start = Instant::now();
+            let ok = model.parse_parallel(corpus.lines(), options, |_, _, t| tokens += t.len());
+            let elapsed = start.elapsed().as_secs_f64();
+            assert!(ok);
+
+            println!(
+                "threads={threads:<3} order={order:<9?} {:>10.0} sentences/s {:>8.2} MB/s {:>10.0} tokens/s",
+                sentences as f64 / elapsed,
+                bytes as f64 / elapsed / 1e6,
+                tokens as f64 / elapsed,
+            );
+        }
+        threads *= 2;
+    }
+}
@@ -0,0 +1,194 @@
+//! Per-sentence cost of the wrapper, measured with criterion and compared with the same loops
+//! written in pure C++ (`lib/baseline.cpp`).
+//!
+//! ```sh
+//! MECAB_ARGS="-d /path/to/dic" MECAB_BENCH_CORPUS=corpus.txt \
+//!     cargo bench --features baseline --bench wrapper
+//! ```
+//!
+//! Each benchmark runs over the first `BATCH` lines of the corpus. After the criterion report,
+//! the FFI overhead of each Rust/C++ pair is printed as a separate number.
+
+mod common;
+
+use mecab_wrapper::baseline::{self, Mode};
+use mecab_wrapper::{FeatureFields, FeatureReader, Lattice, Model, RequestType, Tagger};
+
+use criterion::{black_box, criterion_group, BenchmarkId, Criterion, Throughput};
+
+use std::time::{Duration, Instant};
+
+const BATCH: usize = 1000;
+const NBEST: usize = 3;
+
+struct Fixture {
+    model: Model,
+    inputs: Vec<String>,
+}
+
+impl Fixture {
+    fn new() -> Option<Self> {
+        let model = common::model()?;
+        let corpus = common::corpus(BATCH);
+        let inputs = corpus.lines().take(BATCH).map(String::from).collect();
+        Some(Self { model, inputs })
+    }
+
+    fn inputs(&self) -> Vec<&str> {
+        self.inputs.iter().map(String::as_str).collect()
+    }
+}
+
+/// The Rust side of each pair. Returns the same checksum as [`baseline::run()`].
+fn run(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>, inputs: &[&str], mode: Mode) -> usize {
+    let mut sum = 0;
+    for input in inputs {
+        lattice.set_sentence(input);
+        if !tagger.parse(lattice) {
+            return 0;
+        }
+
+        sum += match mode {
+            Mode::Parse => 1,
+            Mode::Iterate => lattice
+                .iter_nodes()
+                .map(|node| node.surface().len() + node.features().len())
+                .sum(),
+            Mode::ToString => lattice.to_bytes().len(),
+            Mode::Nbest(n) => lattice.nbest_to_bytes(n).len(),
+        };
+    }
+    sum
+}
+
+const MODES: [(&str, Mode); 4] = [
+    ("parse", Mode::Parse),
+    ("iterate", Mode::Iterate),
+    ("to_bytes", Mode::ToString),
+    ("nbest_to_bytes", Mode::Nbest(NBEST)),
+];
+
+fn lattice_for<'m>(model: &'m Model, mode: Mode) -> Lattice<'m> {
+    let mut lattice = model.create_lattice();
+    if let Mode::Nbest(_) = mode {
+        lattice.set_request_type(RequestType::N_BEST);
+    }
+    lattice
+}
+
+fn bench_pairs(c: &mut Criterion, fixture: &Fixture) {
+    let tagger = fixture.model.create_tagger().unwrap();
+    let inputs = fixture.inputs();
+
+    for (name, mode) in MODES {
+        let mut lattice = lattice_for(&fixture.model, mode);
+        assert_eq!(
+            run(&tagger, &mut lattice, &inputs, mode),
+            baseline::run(&tagger, &mut lattice, &inputs, mode),
+            "{name}: the Rust and C++ loops do different work",
+        );
+
+        let mut group = c.benchmark_group(name);
+        group.throughput(Throughput::Elements(inputs.len() as u64));
+        group.bench_function(BenchmarkId::new("rust", inputs.len()), |b| {
+            b.iter(|| black_box(run(&tagger, &mut lattice, &inputs, mode)))
+        });
+        group.bench_function(BenchmarkId::new("cpp", inputs.len()), |b| {
+            b.iter(|| black_box(baseline::run(&tagger, &mut lattice, &inputs, mode)))
+        });
+        group.finish();
+    }
+}
+
+fn bench_features(c: &mut Criterion, fixture: &Fixture) {
+    let tagger = fixture.model.create_tagger().unwrap();
+    let mut lattice = fixture.model.create_lattice();
+
+    // Features copied out of the lattices, so that only the splitting is measured.
+    let mut feats = Vec::new();
+    for input in fixture.inputs() {
+        lattice.set_sentence(input);
+        assert!(tagger.parse(&mut lattice));
+        feats.extend(lattice.iter_nodes().map(|node| node.features().to_vec()));
+    }
+
+    let mut group = c.benchmark_group("features");
+    group.throughput(Throughput::Elements(feats.len() as u64));
+    group.bench_function("FeatureReader", |b| {
+        b.iter(|| {
+            let mut sum = 0;
+            for f in &feats {
+                let mut reader = FeatureReader::from_features(f);
+                sum += reader.features().unwrap().iter().count();
+            }
+            black_box(sum)
+        })
+    });
+    group.bench_function("FeatureFields", |b| {
+        b.iter(|| {
+            let sum: usize = feats.iter().map(|f| FeatureFields::new(f).count()).sum();
+            black_box(sum)
+        })
+    });
+    group.finish();
+}
+
+fn benches(c: &mut Criterion) {
+    if let Some(fixture) = Fixture::new() {
+        bench_pairs(c, &fixture);
+        bench_features(c, &fixture);
+    }
+}
+
+criterion_group!(wrapper, benches);
+
+/// The best of `rounds` runs of `f`.
+fn best_of(rounds: usize, mut f: impl FnMut()) -> Duration {
+    (0..rounds)
+        .map(|_| {
+            let start = Instant::now();
+            f();
+            start.elapsed()
+        })
+        .min()
+        .unwrap()
+}
+
+/// Prints the difference of the Rust and C++ loops per sentence.
+fn report_overhead() {
+    let fixture = if let Some(fixture) = Fixture::new() {
+        fixture
+    } else {
+        return;
+    };
+    let tagger = fixture.model.create_tagger().unwrap();
+    let inputs = fixture.inputs();
+    let per_sentence = |d: Duration| d.as_nanos() as f64 / inputs.len() as f64;
+
+    println!(
+        "\nFFI overhead per sentence (best of 10 runs over {} sentences)",
+        inputs.len()
+    );
+    for (name, mode) in MODES {
+        let mut lattice = lattice_for(&fixture.model, mode);
+        let rust = best_of(10, || {
+            black_box(run(&tagger, &mut lattice, &inputs, mode));
+        });
+        let cpp = best_of(10, || {
+            black_box(baseline::run(&tagger, &mut lattice, &inputs, mode));
+        });
+
+        let (rust, cpp) = (per_sentence(rust), per_sentence(cpp));
+        println!(
+            "{name:<15} rust {rust:>9.1} ns  cpp {cpp:>9.1} ns  overhead {:>+8.1} ns ({:+.1}%)",
+            rust - cpp,
+            (rust - cpp) / cpp * 100.0,
+        );
+    }
+}
+
+fn main() {
+    wrapper();
+    Criterion::default().configure_from_args().final_summary();
+    report_overhead();
+}
@@ -1,11 +1,13 @@
 #[cfg(feature = "cmecab")]
 fn main() {
     println!("cargo:rerun-if-changed=lib/cmecab.cpp");
-    cc::Build::new()
-        .cpp(true)
-        .file("lib/cmecab.cpp")
-        .cpp_link_stdlib("stdc++")
-        .compile("libcmecab.a");
+    let mut build = cc::Build::new();
+    build.cpp(true).file("lib/cmecab.cpp");
+    if cfg!(feature = "baseline") {
+        println!("cargo:rerun-if-changed=lib/baseline.cpp");
+        build.file("lib/baseline.cpp");
+    }
+    build.cpp_link_stdlib("stdc++").compile("libcmecab.a");
     println!("cargo:rustc-link-lib=mecab");
 }
 
@@ -0,0 +1,48 @@
+// Pure C++ baseline for `benches/wrapper.rs`. Built only with the `baseline` feature.
+#include <mecab.h>
+
+#include <cstring>
+
+using namespace MeCab;
+
+enum baseline_mode {
+    BASELINE_PARSE = 0,
+    BASELINE_ITERATE = 1,
+    BASELINE_TO_STRING = 2,
+    BASELINE_NBEST = 3,
+};
+
+// Runs the same loop as the Rust benchmark for each input entirely in C++.
+//
+// Returns a checksum (nodes visited or bytes rendered) so that the work cannot be optimized away,
+// or 0 if some input cannot be parsed.
+extern "C" size_t baseline_run(void *void_tagger, void *void_lattice, const char **inputs, const size_t *lens, size_t n, int mode, size_t nbest) {
+    Tagger *tagger = (Tagger *)void_tagger;
+    Lattice *lattice = (Lattice *)void_lattice;
+
+    size_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        lattice->set_sentence(inputs[i], lens[i]);
+        if (!tagger->parse(lattice)) {
+            return 0;
+        }
+
+        switch (mode) {
+        case BASELINE_ITERATE:
+            for (const Node *node = lattice->bos_node(); node; node = node->next) {
+                sum += node->length + std::strlen(node->feature);
+            }
+            break;
+        case BASELINE_TO_STRING:
+            sum += std::strlen(lattice->toString());
+            break;
+        case BASELINE_NBEST:
+            sum += std::strlen(lattice->enumNBestAsString(nbest));
+            break;
+        default:
+            sum += 1;
+            break;
+        }
+    }
+    return sum;
+}
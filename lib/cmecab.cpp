@@ -1,5 +1,8 @@
 #include <mecab.h>
 
+#include <cstring>
+#include <vector>
+
 using namespace MeCab;
 
 extern "C" const char *get_global_error() {
@@ -39,6 +42,34 @@ extern "C" int transition_cost(void *void_model, unsigned short rattr, unsigned
     return model->transition_cost(rattr, lattr);
 }
 
+// Copies the whole connection matrix into `out`, indexed by `rattr + lsize * lattr` like the
+// matrix in MeCab. `out` must have room for `lsize * rsize` elements of `dictionary_info()`.
+extern "C" void fill_connection_matrix(void *void_model, short *out) {
+    Model *model = (Model *)void_model;
+    const DictionaryInfo *info = model->dictionary_info();
+    size_t lsize = info->lsize;
+    size_t rsize = info->rsize;
+    for (size_t l = 0; l < rsize; ++l) {
+        for (size_t r = 0; r < lsize; ++r) {
+            out[r + lsize * l] = (short)model->transition_cost((unsigned short)r, (unsigned short)l);
+        }
+    }
+}
+
+// Evaluates `n` (rattr, lattr) pairs. Returns the number of pairs evaluated, which is less than `n`
+// if some pair is out of the matrix; MeCab itself does not check the bound.
+extern "C" size_t transition_costs(void *void_model, const unsigned short *rattrs, const unsigned short *lattrs, size_t n, int *out) {
+    Model *model = (Model *)void_model;
+    const DictionaryInfo *info = model->dictionary_info();
+    for (size_t i = 0; i < n; ++i) {
+        if (rattrs[i] >= info->lsize || lattrs[i] >= info->rsize) {
+            return i;
+        }
+        out[i] = model->transition_cost(rattrs[i], lattrs[i]);
+    }
+    return n;
+}
+
 extern "C" bool swap_model(void *void_model, void *void_new_model) {
     Model *model = (Model *)void_model;
     Model *new_model = (Model *)void_new_model;
@@ -184,6 +215,25 @@ extern "C" void remove_request_type(void *void_lattice, int request_type) {
     lattice->remove_request_type(request_type);
 }
 
+// Head of the `bnext` list of the nodes beginning at byte `pos`, or null if the lattice is not
+// parsed or `pos` is out of the sentence. MeCab itself does not check the bound.
+extern "C" void *lattice_begin_nodes(void *void_lattice, size_t pos) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    if (!lattice->bos_node() || pos > lattice->size()) {
+        return nullptr;
+    }
+    return (void *)lattice->begin_nodes(pos);
+}
+
+// Head of the `enext` list of the nodes ending at byte `pos`. See `lattice_begin_nodes`.
+extern "C" void *lattice_end_nodes(void *void_lattice, size_t pos) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    if (!lattice->bos_node() || pos > lattice->size()) {
+        return nullptr;
+    }
+    return (void *)lattice->end_nodes(pos);
+}
+
 extern "C" bool next_lattice(void *void_lattice) {
     Lattice *lattice = (Lattice *)void_lattice;
     return lattice->next();
@@ -270,3 +320,390 @@ extern "C" void *next_node(void *void_node) {
     const Node* node = (const Node*)void_node;
     return node->next;
 }
+
+// Counters of a parsed lattice (`LatticeStats`).
+struct lattice_stats_t {
+    size_t nodes;
+    size_t unknown_nodes;
+    size_t best_path_nodes;
+    size_t paths;
+    size_t bytes;
+};
+
+// Counts the nodes and paths of `lattice`. `bytes` is an estimate: MeCab does not expose its
+// allocator, so it counts only the nodes and paths.
+extern "C" void lattice_stats(void *void_lattice, lattice_stats_t *stats) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    std::memset(stats, 0, sizeof(*stats));
+    if (!lattice->bos_node()) {
+        return;
+    }
+
+    for (size_t pos = 0; pos <= lattice->size(); ++pos) {
+        for (const Node *node = lattice->begin_nodes(pos); node; node = node->bnext) {
+            ++stats->nodes;
+            if (node->stat == MECAB_UNK_NODE) {
+                ++stats->unknown_nodes;
+            }
+            for (const Path *path = node->lpath; path; path = path->lnext) {
+                ++stats->paths;
+            }
+        }
+    }
+    // BOS is only in `end_nodes(0)`.
+    stats->nodes += 1;
+
+    for (const Node *node = lattice->bos_node(); node; node = node->next) {
+        ++stats->best_path_nodes;
+    }
+    stats->bytes = stats->nodes * sizeof(Node) + stats->paths * sizeof(Path);
+}
+
+// Struct-of-arrays token columns owned by the Rust side (`TokenBuffer`).
+//
+// Every column has `len` initialized elements and room for `cap`. When it runs out of room, the
+// shim calls `reserve`, which grows the columns and refreshes all the pointers below.
+struct token_sink_t {
+    void *ctx;
+    bool (*reserve)(token_sink_t *sink, size_t tokens, size_t bytes);
+
+    size_t len;
+    size_t cap;
+    size_t *begin;
+    unsigned short *length;
+    unsigned short *posid;
+    unsigned short *rattr;
+    unsigned short *lattr;
+    short *wcost;
+    long *cost;
+    unsigned char *stat;
+    size_t *feature_end;
+
+    char *features;
+    size_t features_len;
+    size_t features_cap;
+
+    // Reserved by the caller for all the sentences in a call, so this never grows.
+    size_t *sentence_end;
+    size_t sentences_len;
+};
+
+static bool sink_reserve(token_sink_t *sink, size_t tokens, size_t bytes) {
+    if (sink->len + tokens <= sink->cap && sink->features_len + bytes <= sink->features_cap) {
+        return true;
+    }
+    return sink->reserve(sink, tokens, bytes);
+}
+
+// Appends `node`, whose surface offset is taken relative to `base`.
+static bool sink_node(token_sink_t *sink, const Node *node, const char *base) {
+    size_t feature_len = std::strlen(node->feature);
+    if (!sink_reserve(sink, 1, feature_len)) {
+        return false;
+    }
+
+    size_t i = sink->len;
+    sink->begin[i] = node->surface - base;
+    sink->length[i] = node->length;
+    sink->posid[i] = node->posid;
+    sink->rattr[i] = node->rcAttr;
+    sink->lattr[i] = node->lcAttr;
+    sink->wcost[i] = node->wcost;
+    sink->cost[i] = node->cost;
+    sink->stat[i] = node->stat;
+
+    std::memcpy(sink->features + sink->features_len, node->feature, feature_len);
+    sink->features_len += feature_len;
+    sink->feature_end[i] = sink->features_len;
+
+    sink->len = i + 1;
+    return true;
+}
+
+static void sink_close_sentence(token_sink_t *sink) {
+    sink->sentence_end[sink->sentences_len] = sink->len;
+    sink->sentences_len += 1;
+}
+
+// Appends the best path of `lattice` (without BOS/EOS) and closes the sentence.
+static bool sink_lattice(token_sink_t *sink, Lattice *lattice) {
+    const char *sentence = lattice->sentence();
+
+    for (const Node *node = lattice->bos_node(); node; node = node->next) {
+        if (node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE) {
+            continue;
+        }
+        if (!sink_node(sink, node, sentence)) {
+            return false;
+        }
+    }
+
+    sink_close_sentence(sink);
+    return true;
+}
+
+// Appends the `bnext` chain of `Model::lookup(begin, end)` as one sentence. The lattice only
+// provides the node allocator and is cleared first, so the nodes never pile up.
+static bool sink_lookup(token_sink_t *sink, Model *model, Lattice *lattice, const char *base, const char *begin, const char *end) {
+    lattice->clear();
+    for (const Node *node = model->lookup(begin, end, lattice); node; node = node->bnext) {
+        if (!sink_node(sink, node, base)) {
+            return false;
+        }
+    }
+    sink_close_sentence(sink);
+    return true;
+}
+
+// Parses `n` sentences one by one in `lattice` and appends all the tokens to `sink`.
+//
+// Returns the number of sentences parsed successfully; it is less than `n` if the parser fails.
+extern "C" size_t parse_batch(void *void_tagger, void *void_lattice, const char **inputs, const size_t *lens, size_t n, token_sink_t *sink) {
+    Tagger *tagger = (Tagger *)void_tagger;
+    Lattice *lattice = (Lattice *)void_lattice;
+
+    for (size_t i = 0; i < n; ++i) {
+        lattice->set_sentence(inputs[i], lens[i]);
+        if (!tagger->parse(lattice) || !sink_lattice(sink, lattice)) {
+            return i;
+        }
+    }
+    return n;
+}
+
+extern "C" bool export_tokens(void *void_lattice, token_sink_t *sink) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    return sink_lattice(sink, lattice);
+}
+
+// Common prefix search of each of `n` inputs; the matches of each input make one sentence whose
+// surface offsets are relative to the input.
+//
+// Returns the number of inputs looked up; it is less than `n` if `sink` cannot grow.
+extern "C" size_t lookup_batch(void *void_model, void *void_lattice, const char **inputs, const size_t *lens, size_t n, token_sink_t *sink) {
+    Model *model = (Model *)void_model;
+    Lattice *lattice = (Lattice *)void_lattice;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!sink_lookup(sink, model, lattice, inputs[i], inputs[i], inputs[i] + lens[i])) {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Common prefix search of every suffix of `text` starting at a UTF-8 character boundary; the
+// matches of each suffix make one sentence whose surface offsets are relative to `text`.
+//
+// Returns false if `sink` cannot grow.
+extern "C" bool lookup_suffixes(void *void_model, void *void_lattice, const char *text, size_t len, token_sink_t *sink) {
+    Model *model = (Model *)void_model;
+    Lattice *lattice = (Lattice *)void_lattice;
+
+    for (size_t i = 0; i < len; ++i) {
+        if (((unsigned char)text[i] & 0xc0) == 0x80) {
+            continue;
+        }
+        if (!sink_lookup(sink, model, lattice, text, text + i, text + len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Struct-of-arrays lattice graph owned by the Rust side (`LatticeGraph`).
+//
+// Node columns have `nodes_len` elements and edge columns `edges_len`; the incoming edges of the
+// `i`-th node are `edge_end[i - 1]..edge_end[i]`. `reserve` makes room for the given numbers of
+// nodes and edges in total, and refreshes all the pointers below.
+struct graph_sink_t {
+    void *ctx;
+    bool (*reserve)(graph_sink_t *sink, size_t nodes, size_t edges);
+
+    size_t nodes_len;
+    size_t nodes_cap;
+    size_t *begin;
+    unsigned short *length;
+    unsigned short *posid;
+    unsigned short *rattr;
+    unsigned short *lattr;
+    short *wcost;
+    long *cost;
+    unsigned char *stat;
+    float *alpha;
+    float *beta;
+    float *prob;
+    size_t *edge_end;
+
+    size_t edges_len;
+    size_t edges_cap;
+    size_t *lnode;
+    int *edge_cost;
+    float *edge_prob;
+};
+
+// Flattens every node of `lattice` into `sink` in topological order: BOS, the nodes by begin
+// position, then EOS. Nodes (except BOS/EOS) and edges whose marginal probability is less than
+// `min_prob` are dropped, as well as the edges from dropped nodes.
+extern "C" bool export_graph(void *void_lattice, float min_prob, graph_sink_t *sink) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    Node *bos = lattice->bos_node();
+    Node *eos = lattice->eos_node();
+    if (!bos || !eos) {
+        return false;
+    }
+
+    // Reused between calls to avoid allocating for every sentence.
+    static thread_local std::vector<const Node *> nodes;
+    static thread_local std::vector<size_t> index_of;
+    nodes.clear();
+
+    nodes.push_back(bos);
+    size_t edges = 0;
+    unsigned int max_id = bos->id;
+    for (size_t pos = 0; pos < lattice->size(); ++pos) {
+        for (const Node *node = lattice->begin_nodes(pos); node; node = node->bnext) {
+            if (node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE || node->prob < min_prob) {
+                continue;
+            }
+            nodes.push_back(node);
+        }
+    }
+    nodes.push_back(eos);
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i]->id > max_id) {
+            max_id = nodes[i]->id;
+        }
+        for (const Path *path = nodes[i]->lpath; path; path = path->lnext) {
+            ++edges;
+        }
+    }
+
+    // Node IDs are dense in a lattice, so a table is cheaper than a hash map.
+    const size_t none = (size_t)-1;
+    index_of.assign((size_t)max_id + 1, none);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        index_of[nodes[i]->id] = i;
+    }
+
+    if ((sink->nodes_cap < nodes.size() || sink->edges_cap < edges) && !sink->reserve(sink, nodes.size(), edges)) {
+        return false;
+    }
+
+    const char *sentence = lattice->sentence();
+    size_t e = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node *node = nodes[i];
+        sink->begin[i] = node->surface - sentence;
+        sink->length[i] = node->length;
+        sink->posid[i] = node->posid;
+        sink->rattr[i] = node->rcAttr;
+        sink->lattr[i] = node->lcAttr;
+        sink->wcost[i] = node->wcost;
+        sink->cost[i] = node->cost;
+        sink->stat[i] = node->stat;
+        sink->alpha[i] = node->alpha;
+        sink->beta[i] = node->beta;
+        sink->prob[i] = node->prob;
+
+        for (const Path *path = node->lpath; path; path = path->lnext) {
+            if (!path->lnode || path->lnode->id > max_id || path->prob < min_prob) {
+                continue;
+            }
+            size_t l = index_of[path->lnode->id];
+            if (l == none || nodes[l] != path->lnode) {
+                continue;
+            }
+            sink->lnode[e] = l;
+            sink->edge_cost[e] = path->cost;
+            sink->edge_prob[e] = path->prob;
+            ++e;
+        }
+        sink->edge_end[i] = e;
+    }
+    sink->nodes_len = nodes.size();
+    sink->edges_len = e;
+    return true;
+}
+
+// Growable byte buffer owned by the Rust side (`Vec<u8>`). `reserve` makes room for `size` more
+// bytes and refreshes `ptr` and `cap`.
+struct byte_sink_t {
+    void *ctx;
+    bool (*reserve)(byte_sink_t *sink, size_t size);
+    char *ptr;
+    size_t len;
+    size_t cap;
+};
+
+// Appends `s`, rendered into the lattice's own buffer, to `sink`, growing it so that the next
+// call fits.
+static bool sink_copy(byte_sink_t *sink, const char *s) {
+    if (!s) {
+        return false;
+    }
+    size_t len = std::strlen(s);
+    if (sink->len + len + 1 > sink->cap && !sink->reserve(sink, len + 1)) {
+        return false;
+    }
+    std::memcpy(sink->ptr + sink->len, s, len);
+    sink->len += len;
+    return true;
+}
+
+// Renders directly into the spare capacity of `sink` by `into(buf, size)`. MeCab never frees a
+// caller-provided buffer but fails if it is too small; then renders into the lattice's own buffer
+// by `internal()` and copies it. Only for stateless renderings, as `internal()` renders again.
+template <class Into, class Internal>
+static bool sink_render(Lattice *lattice, byte_sink_t *sink, Into into, Internal internal) {
+    size_t room = sink->cap - sink->len;
+    if (room > 0) {
+        const char *s = into(sink->ptr + sink->len, room);
+        if (s) {
+            sink->len += std::strlen(s);
+            return true;
+        }
+    }
+
+    const char *s = internal();
+    if (s) {
+        // The overflow above is not an error for the caller.
+        lattice->set_what("");
+    }
+    return sink_copy(sink, s);
+}
+
+extern "C" bool lattice_write(void *void_lattice, byte_sink_t *sink) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    return sink_render(
+        lattice, sink,
+        [=](char *buf, size_t size) { return lattice->toString(buf, size); },
+        [=]() { return lattice->toString(); });
+}
+
+extern "C" bool nbest_write(void *void_lattice, size_t n, byte_sink_t *sink) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    // Each enumNBestAsString() call advances the N-best generator, even when it fails for lack
+    // of room, so a failed attempt into `sink` cannot be retried: render once and copy.
+    return sink_copy(sink, lattice->enumNBestAsString(n));
+}
+
+extern "C" bool node_write(void *void_lattice, const void *void_node, byte_sink_t *sink) {
+    Lattice *lattice = (Lattice *)void_lattice;
+    const Node* node = (const Node*)void_node;
+    return sink_render(
+        lattice, sink,
+        [=](char *buf, size_t size) { return lattice->toString(node, buf, size); },
+        [=]() { return lattice->toString(node); });
+}
+
+// Compiles the user dictionary `csv` into `output`, the same as
+// `mecab-dict-index -d dicdir -u output -f charset -t charset csv`.
+extern "C" bool compile_user_dictionary(const char *dicdir, const char *csv, const char *output,
+                                        const char *charset) {
+    const char *argv[] = {"mecab-dict-index", "-d", dicdir, "-u", output,
+                          "-f", charset, "-t", charset, csv};
+    int argc = sizeof(argv) / sizeof(argv[0]);
+    return mecab_dict_index(argc, const_cast<char **>(argv)) == 0;
+}
@@ -0,0 +1,332 @@
+use crate::ffi::{Model, TokenBuffer, Tokens};
+
+use std::collections::VecDeque;
+use std::error::Error;
+use std::fmt;
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::{Arc, Condvar, Mutex};
+use std::task::{Context, Poll, Waker};
+use std::thread::JoinHandle;
+
+/// Options of [`AsyncTagger::new()`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct AsyncOptions {
+    /// The number of worker threads.
+    pub threads: usize,
+    /// The number of requests which may wait in the queue. Futures wait to be queued while it is
+    /// full.
+    pub queue_capacity: usize,
+    /// The maximum number of queued requests a worker parses in one batch.
+    pub max_batch: usize,
+}
+
+impl Default for AsyncOptions {
+    fn default() -> Self {
+        let threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+        Self::new(threads)
+    }
+}
+
+impl AsyncOptions {
+    /// Options for `threads` workers, with a queue of `threads * 64` requests and batches of 16.
+    pub fn new(threads: usize) -> Self {
+        let threads = threads.max(1);
+        Self {
+            threads,
+            queue_capacity: threads * 64,
+            max_batch: 16,
+        }
+    }
+
+    /// Sets [`AsyncOptions::queue_capacity`].
+    #[inline]
+    pub fn queue_capacity(mut self, queue_capacity: usize) -> Self {
+        self.queue_capacity = queue_capacity.max(1);
+        self
+    }
+
+    /// Sets [`AsyncOptions::max_batch`].
+    #[inline]
+    pub fn max_batch(mut self, max_batch: usize) -> Self {
+        self.max_batch = max_batch.max(1);
+        self
+    }
+}
+
+/// Error of [`ParseFuture`].
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum AsyncError {
+    /// MeCab failed to parse the text, with the error message of the lattice.
+    Parse(String),
+    /// The [`AsyncTagger`] was dropped before the text was parsed.
+    Shutdown,
+}
+
+impl fmt::Display for AsyncError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            Self::Parse(msg) => write!(f, "parse failed: {msg}"),
+            Self::Shutdown => f.write_str("tagger is shut down"),
+        }
+    }
+}
+
+impl Error for AsyncError {}
+
+/// Requests parsed together, shared by their results.
+#[derive(Debug)]
+struct Batch {
+    texts: Vec<String>,
+    tokens: TokenBuffer,
+}
+
+/// Result of [`AsyncTagger::parse()`]: the text and its tokens.
+#[derive(Debug, Clone)]
+pub struct Parsed {
+    batch: Arc<Batch>,
+    index: usize,
+}
+
+impl Parsed {
+    /// The parsed text.
+    #[inline]
+    pub fn text(&self) -> &str {
+        &self.batch.texts[self.index]
+    }
+
+    /// Tokens of [`Parsed::text()`]. Surface ranges are relative to the text.
+    #[inline]
+    pub fn tokens(&self) -> Tokens<'_> {
+        self.batch.tokens.sentence(self.index).unwrap()
+    }
+}
+
+type Outcome = Result<Parsed, AsyncError>;
+
+#[derive(Default)]
+struct Slot {
+    state: Mutex<(Option<Outcome>, Option<Waker>)>,
+}
+
+impl Slot {
+    fn complete(&self, outcome: Outcome) {
+        let mut state = self.state.lock().unwrap();
+        state.0 = Some(outcome);
+        if let Some(waker) = state.1.take() {
+            waker.wake();
+        }
+    }
+}
+
+struct Request {
+    text: String,
+    slot: Arc<Slot>,
+}
+
+struct QueueState {
+    requests: VecDeque<Request>,
+    /// Futures waiting for room in the queue.
+    senders: Vec<Waker>,
+    closed: bool,
+}
+
+struct Queue {
+    state: Mutex<QueueState>,
+    ready: Condvar,
+    capacity: usize,
+}
+
+impl Queue {
+    /// Takes up to `max` requests, waiting for at least one. Returns `None` when the queue is
+    /// closed and empty.
+    fn pop_batch(&self, max: usize, batch: &mut Vec<Request>) -> Option<()> {
+        let mut state = self.state.lock().unwrap();
+        while state.requests.is_empty() {
+            if state.closed {
+                return None;
+            }
+            state = self.ready.wait(state).unwrap();
+        }
+        let n = state.requests.len().min(max);
+        batch.extend(state.requests.drain(..n));
+        for waker in state.senders.drain(..) {
+            waker.wake();
+        }
+        Some(())
+    }
+}
+
+/// Tokenizer for async code, backed by a fixed pool of OS threads.
+///
+/// Parsing is CPU-bound and blocks the calling thread, so running [`Tagger::parse()`] on an async
+/// executor stalls the other tasks. `AsyncTagger` instead sends each text to a bounded queue,
+/// served by its own worker threads with one [`Lattice`](crate::Lattice) each, and returns a
+/// future of the result. An idle worker takes up to [`max_batch`](AsyncOptions::max_batch)
+/// queued texts at once and parses them in one
+/// [`Tagger::parse_batch()`](crate::Tagger::parse_batch()) call, so small requests arriving in a
+/// burst share the FFI round trip.
+///
+/// If the queue is full, the returned future waits until a worker takes some requests, applying
+/// backpressure without blocking the executor. The futures do not depend on any async runtime.
+///
+/// Dropping the `AsyncTagger` lets the workers finish the queued requests and joins them.
+///
+/// ```no_run
+/// use mecab_wrapper::{AsyncOptions, AsyncTagger, Model};
+/// use std::sync::Arc;
+///
+/// #[tokio::main]
+/// async fn main() {
+///     let model = Arc::new(Model::new("").unwrap());
+///     let tagger = AsyncTagger::new(model, AsyncOptions::new(4)).unwrap();
+///
+///     let parsed = tagger.parse("すもももももももものうち").await.unwrap();
+///     for token in parsed.tokens() {
+///         println!("{}", &parsed.text()[token.surface_range()]);
+///     }
+/// }
+/// ```
+///
+/// [`Tagger::parse()`]: crate::Tagger::parse()
+pub struct AsyncTagger {
+    queue: Arc<Queue>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+impl AsyncTagger {
+    /// Starts `options.threads` workers parsing with `model`.
+    ///
+    /// Returns `None` if a tagger cannot be created.
+    pub fn new(model: Arc<Model>, options: AsyncOptions) -> Option<Self> {
+        // Fail here rather than in the workers.
+        drop(model.create_tagger()?);
+
+        let queue = Arc::new(Queue {
+            state: Mutex::new(QueueState {
+                requests: VecDeque::with_capacity(options.queue_capacity),
+                senders: Vec::new(),
+                closed: false,
+            }),
+            ready: Condvar::new(),
+            capacity: options.queue_capacity.max(1),
+        });
+
+        let max_batch = options.max_batch.max(1);
+        let workers = (0..options.threads.max(1))
+            .map(|_| {
+                let (model, queue) = (Arc::clone(&model), Arc::clone(&queue));
+                std::thread::spawn(move || work(&model, &queue, max_batch))
+            })
+            .collect();
+
+        Some(Self { queue, workers })
+    }
+
+    /// Parses `text` on a worker thread.
+    pub fn parse<S: Into<String>>(&self, text: S) -> ParseFuture {
+        let request = Request {
+            text: text.into(),
+            slot: Arc::default(),
+        };
+        ParseFuture {
+            queue: Arc::clone(&self.queue),
+            slot: Arc::clone(&request.slot),
+            request: Some(request),
+        }
+    }
+
+    /// The number of requests waiting in the queue.
+    pub fn queued(&self) -> usize {
+        self.queue.state.lock().unwrap().requests.len()
+    }
+}
+
+impl Drop for AsyncTagger {
+    fn drop(&mut self) {
+        {
+            let mut state = self.queue.state.lock().unwrap();
+            state.closed = true;
+            for waker in state.senders.drain(..) {
+                waker.wake();
+            }
+        }
+        self.queue.ready.notify_all();
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+    }
+}
+
+fn work(model: &Model, queue: &Queue, max_batch: usize) {
+    let tagger = model.create_tagger().unwrap();
+    let mut lattice = model.create_lattice();
+    let mut requests = Vec::with_capacity(max_batch);
+
+    while queue.pop_batch(max_batch, &mut requests).is_some() {
+        while !requests.is_empty() {
+            let mut tokens = TokenBuffer::new();
+            let inputs: Vec<&str> = requests.iter().map(|r| r.text.as_str()).collect();
+            let ok = tagger.parse_batch(&mut lattice, &inputs, &mut tokens);
+
+            let parsed = tokens.sentence_count();
+            // Requests after the failed one are parsed again in the next round.
+            let rest = if ok {
+                Vec::new()
+            } else {
+                let mut rest = requests.split_off(parsed);
+                let failed = rest.remove(0);
+                let msg = String::from_utf8_lossy(lattice.error()).into_owned();
+                failed.slot.complete(Err(AsyncError::Parse(msg)));
+                rest
+            };
+
+            let (texts, slots): (Vec<_>, Vec<_>) =
+                requests.drain(..).map(|r| (r.text, r.slot)).unzip();
+            let batch = Arc::new(Batch { texts, tokens });
+            for (index, slot) in slots.into_iter().enumerate() {
+                let batch = Arc::clone(&batch);
+                slot.complete(Ok(Parsed { batch, index }));
+            }
+
+            requests = rest;
+        }
+    }
+}
+
+/// Future returned by [`AsyncTagger::parse()`].
+pub struct ParseFuture {
+    queue: Arc<Queue>,
+    slot: Arc<Slot>,
+    /// The request not queued yet.
+    request: Option<Request>,
+}
+
+impl Future for ParseFuture {
+    type Output = Result<Parsed, AsyncError>;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        if self.request.is_some() {
+            let queue = Arc::clone(&self.queue);
+            let mut state = queue.state.lock().unwrap();
+            if state.closed {
+                return Poll::Ready(Err(AsyncError::Shutdown));
+            }
+            if state.requests.len() >= queue.capacity {
+                state.senders.push(cx.waker().clone());
+                return Poll::Pending;
+            }
+            let request = self.request.take().unwrap();
+            state.requests.push_back(request);
+            drop(state);
+            queue.ready.notify_one();
+        }
+
+        let mut state = self.slot.state.lock().unwrap();
+        if let Some(outcome) = state.0.take() {
+            return Poll::Ready(outcome);
+        }
+        state.1 = Some(cx.waker().clone());
+        Poll::Pending
+    }
+}
@@ -0,0 +1,58 @@
+//! Pure C++ counterparts of the loops in `benches/wrapper.rs`, built from `lib/baseline.cpp`.
+//!
+//! This module exists only for benchmarks and is enabled by the `baseline` feature.
+
+use crate::ffi::{Lattice, Tagger};
+
+use libc::{c_char, c_int, c_void, size_t};
+
+#[link(name = "cmecab")]
+extern "C" {
+    fn baseline_run(
+        tagger: *mut c_void,
+        lattice: *mut c_void,
+        inputs: *const *const c_char,
+        lens: *const size_t,
+        n: size_t,
+        mode: c_int,
+        nbest: size_t,
+    ) -> size_t;
+}
+
+/// What [`run()`] does for each sentence after parsing it.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Mode {
+    /// Nothing.
+    Parse,
+    /// Walk the best path, touching the surface and the features of each node.
+    Iterate,
+    /// `MeCab::Lattice::toString()`.
+    ToString,
+    /// `MeCab::Lattice::enumNBestAsString(n)`.
+    Nbest(usize),
+}
+
+/// Parses each of `inputs` in `lattice` and does `mode`, entirely in C++.
+///
+/// Returns a checksum of the work, or 0 if some input cannot be parsed.
+pub fn run(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>, inputs: &[&str], mode: Mode) -> usize {
+    let ptrs: Vec<*const c_char> = inputs.iter().map(|s| s.as_ptr() as _).collect();
+    let lens: Vec<size_t> = inputs.iter().map(|s| s.len()).collect();
+    let (mode, nbest) = match mode {
+        Mode::Parse => (0, 0),
+        Mode::Iterate => (1, 0),
+        Mode::ToString => (2, 0),
+        Mode::Nbest(n) => (3, n),
+    };
+    unsafe {
+        baseline_run(
+            tagger.as_ptr(),
+            lattice.as_mut_ptr(),
+            ptrs.as_ptr(),
+            lens.as_ptr(),
+            inputs.len(),
+            mode,
+            nbest,
+        )
+    }
+}
@@ -0,0 +1,267 @@
+use crate::ffi::{Boundary, Lattice, Model, Tagger};
+
+use std::io;
+use std::ops::Range;
+
+/// Characters which end a sentence. ASCII `'.'` is handled separately, as it also appears in
+/// numbers and abbreviations.
+const TERMINATORS: [&str; 7] = ["\n", "。", "．", "！", "？", "!", "?"];
+/// Closing brackets kept with the sentence they follow, as in `「はい。」`.
+const CLOSERS: [&str; 5] = ["」", "』", "）", ")", "\""];
+
+/// Options of [`DocumentParser::new()`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct DocumentOptions {
+    /// Upper bound of the bytes parsed in one call. Chunks are cut at the last sentence end
+    /// within this size, or at a character boundary if there is none.
+    pub max_chunk: usize,
+    /// When the nodes and paths of a chunk exceed this size in bytes, the lattice is replaced by
+    /// a new one, returning the memory held by its allocator.
+    pub max_lattice_bytes: usize,
+}
+
+impl Default for DocumentOptions {
+    fn default() -> Self {
+        Self {
+            max_chunk: 16 << 10,
+            max_lattice_bytes: 64 << 20,
+        }
+    }
+}
+
+impl DocumentOptions {
+    /// Sets [`DocumentOptions::max_chunk`].
+    #[inline]
+    pub fn max_chunk(mut self, max_chunk: usize) -> Self {
+        self.max_chunk = max_chunk.max(1);
+        self
+    }
+
+    /// Sets [`DocumentOptions::max_lattice_bytes`].
+    #[inline]
+    pub fn max_lattice_bytes(mut self, max_lattice_bytes: usize) -> Self {
+        self.max_lattice_bytes = max_lattice_bytes;
+        self
+    }
+}
+
+/// A parsed part of the document, returned by [`DocumentParser::next_chunk()`].
+pub struct Chunk<'a, 'm> {
+    offset: usize,
+    lattice: &'a Lattice<'m>,
+}
+
+impl<'a, 'm> Chunk<'a, 'm> {
+    /// Byte offset of the chunk in the document. Add it to the positions in the lattice to get
+    /// positions in the document.
+    #[inline]
+    pub fn offset(&self) -> usize {
+        self.offset
+    }
+
+    /// Byte range of the chunk in the document.
+    #[inline]
+    pub fn range(&self) -> Range<usize> {
+        self.offset..self.offset + self.lattice.sentence_len()
+    }
+
+    /// The lattice of the chunk, valid until the next call of
+    /// [`DocumentParser::next_chunk()`].
+    #[inline]
+    pub fn lattice(&self) -> &'a Lattice<'m> {
+        self.lattice
+    }
+}
+
+/// Tokenizer for documents too long to be parsed as one sentence.
+///
+/// Parsing a multi-megabyte text in one call makes MeCab build a lattice over the whole text, and
+/// its allocator keeps the peak memory until the lattice is destroyed. `DocumentParser` instead
+/// parses the document in chunks of at most [`max_chunk`](DocumentOptions::max_chunk) bytes, cut
+/// at sentence ends, with one lattice reused across chunks. The sentence ends inside a chunk are
+/// set as [`Boundary::Token`] constraints, so that no token spans two sentences. If a chunk
+/// needs more than [`max_lattice_bytes`](DocumentOptions::max_lattice_bytes), the lattice is
+/// replaced by a new one after the chunk is returned, so the memory is bounded by the chunk size
+/// whatever the document size.
+///
+/// ```no_run
+/// use mecab_wrapper::{DocumentOptions, DocumentParser, MmapFile, Model};
+///
+/// # fn test(model: &Model) -> std::io::Result<()> {
+/// let tagger = model.create_tagger().unwrap();
+/// let file = MmapFile::open("book.txt")?;
+/// let mut parser = DocumentParser::new(model, &tagger, &file, DocumentOptions::default());
+///
+/// while let Some(chunk) = parser.next_chunk()? {
+///     for node in chunk.lattice().iter_nodes() {
+///         println!("{}", node.surface_str().unwrap());
+///     }
+/// }
+/// # Ok(())
+/// # }
+/// ```
+pub struct DocumentParser<'a, 'm> {
+    model: &'m Model,
+    tagger: &'a Tagger<'m>,
+    lattice: Lattice<'m>,
+    text: &'a [u8],
+    pos: usize,
+    options: DocumentOptions,
+    /// The lattice is replaced before the next chunk.
+    recycle: bool,
+    recycled: usize,
+}
+
+impl<'a, 'm> DocumentParser<'a, 'm> {
+    /// Parses `text` with `tagger`, which must be created from `model`.
+    pub fn new<T: AsRef<[u8]> + ?Sized>(
+        model: &'m Model,
+        tagger: &'a Tagger<'m>,
+        text: &'a T,
+        options: DocumentOptions,
+    ) -> Self {
+        Self {
+            model,
+            tagger,
+            lattice: model.create_lattice(),
+            text: text.as_ref(),
+            pos: 0,
+            options,
+            recycle: false,
+            recycled: 0,
+        }
+    }
+
+    /// The lattice used for the following chunks, e.g. to set the request type.
+    #[inline]
+    pub fn lattice_mut(&mut self) -> &mut Lattice<'m> {
+        &mut self.lattice
+    }
+
+    /// Byte offset of the first byte not parsed yet.
+    #[inline]
+    pub fn position(&self) -> usize {
+        self.pos
+    }
+
+    /// The number of times the lattice has been replaced.
+    #[inline]
+    pub fn recycled(&self) -> usize {
+        self.recycled
+    }
+
+    /// Parses the next chunk. Returns `Ok(None)` at the end of the document.
+    ///
+    /// If the chunk cannot be parsed, it returns an error of [`io::ErrorKind::Other`] containing
+    /// [`Lattice::error()`], and the next call continues from the following chunk.
+    pub fn next_chunk(&mut self) -> io::Result<Option<Chunk<'_, 'm>>> {
+        if self.recycle {
+            self.recycle_lattice();
+        }
+        let rest = &self.text[self.pos..];
+        if rest.is_empty() {
+            return Ok(None);
+        }
+
+        let len = chunk_len(rest, self.options.max_chunk);
+        let chunk = &rest[..len];
+        let offset = self.pos;
+        self.pos += len;
+
+        self.lattice.set_sentence_bytes(chunk);
+        let mut begin = 0;
+        while let Some(end) = sentence_end(&chunk[begin..]) {
+            begin += end;
+            if begin == len {
+                break;
+            }
+            self.lattice.set_boundary_constraint(begin, Boundary::Token);
+        }
+
+        if !self.tagger.parse(&mut self.lattice) {
+            let e = String::from_utf8_lossy(self.lattice.error()).into_owned();
+            return Err(io::Error::new(io::ErrorKind::Other, e));
+        }
+        self.recycle = self.lattice.stats().bytes > self.options.max_lattice_bytes;
+
+        Ok(Some(Chunk {
+            offset,
+            lattice: &self.lattice,
+        }))
+    }
+
+    fn recycle_lattice(&mut self) {
+        let mut lattice = self.model.create_lattice();
+        lattice.set_request_type(self.lattice.get_request_type());
+        lattice.set_theta(self.lattice.theta());
+        self.lattice = lattice;
+        self.recycle = false;
+        self.recycled += 1;
+    }
+}
+
+/// The end of the first sentence in `text`, including the trailing closing brackets, or `None`
+/// if `text` has no sentence end.
+fn sentence_end(text: &[u8]) -> Option<usize> {
+    let mut i = 0;
+    while i < text.len() {
+        let rest = &text[i..];
+        let term = TERMINATORS
+            .iter()
+            .find(|t| rest.starts_with(t.as_bytes()))
+            .map(|t| t.len())
+            .or_else(|| {
+                let period = rest.len() >= 2 && rest[0] == b'.' && rest[1].is_ascii_whitespace();
+                period.then_some(1)
+            });
+        if let Some(n) = term {
+            let mut end = i + n;
+            while let Some(c) = CLOSERS
+                .iter()
+                .find(|c| text[end..].starts_with(c.as_bytes()))
+            {
+                end += c.len();
+            }
+            return Some(end);
+        }
+        i += 1;
+    }
+    None
+}
+
+/// Length of the next chunk of `text`: all of it if it fits in `max`, otherwise up to the last
+/// sentence end, or else the last ASCII whitespace, or else the last character boundary within
+/// `max` bytes.
+fn chunk_len(text: &[u8], max: usize) -> usize {
+    if text.len() <= max {
+        return text.len();
+    }
+    let head = &text[..max];
+
+    let mut last = None;
+    let mut begin = 0;
+    while let Some(end) = sentence_end(&head[begin..]) {
+        begin += end;
+        last = Some(begin);
+    }
+    if let Some(end) = last {
+        return end;
+    }
+    if let Some(i) = head.iter().rposition(|b| b.is_ascii_whitespace()) {
+        return i + 1;
+    }
+
+    let is_boundary = |i: usize| text.get(i).map_or(true, |&b| (b as i8) >= -0x40);
+    let mut end = max;
+    while end > 0 && !is_boundary(end) {
+        end -= 1;
+    }
+    if end == 0 {
+        // A character longer than `max`.
+        end = max;
+        while !is_boundary(end) {
+            end += 1;
+        }
+    }
+    end
+}
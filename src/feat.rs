@@ -1,6 +1,8 @@
 #[cfg(feature = "cmecab")]
 use crate::ffi::Node;
 
+use crate::Metric;
+
 use csv::ByteRecord;
 use csv::ByteRecordIter;
 use csv::Error as CsvError;
@@ -79,7 +81,8 @@ impl<'a> FeatureReader<'a> {
     ///
     /// This requires `&mut` because [`csv::Reader::byte_headers()`] does so.
     pub fn features(&mut self) -> Result<Features<'_>, CsvError> {
-        let record = self.reader.byte_headers()?;
+        let reader = &mut self.reader;
+        let record = crate::metrics::timed(Metric::Features, || reader.byte_headers())?;
         Ok(Features { record })
     }
 }
@@ -217,6 +220,151 @@ impl<'a> DoubleEndedIterator for IntoIter<'a> {
 
 impl<'a> ExactSizeIterator for IntoIter<'a> {}
 
+/// Iterator of the comma-separated fields of a feature string. Unlike [`FeatureReader`], it
+/// borrows the fields from the given string and never allocates.
+///
+/// A field starting with `'"'` is quoted in the same way as MeCab's CSV tokenizer: it ends at the
+/// next `'"'` that is not followed by another `'"'`, and the quotes are stripped. Since the fields
+/// are borrowed, an escaped quote `""` inside a quoted field is yielded as is.
+///
+/// Commas and quotes are scanned eight bytes at a time, so long feature strings such as those of
+/// UniDic are split quickly.
+///
+/// # Examples
+///
+/// ```
+/// use mecab_wrapper::FeatureFields;
+///
+/// let mut fields = FeatureFields::new(b"a,\"b,c\",,d");
+/// assert_eq!(fields.next(), Some(&b"a"[..]));
+/// assert_eq!(fields.next(), Some(&b"b,c"[..]));
+/// assert_eq!(fields.next(), Some(&b""[..]));
+/// assert_eq!(fields.next(), Some(&b"d"[..]));
+/// assert_eq!(fields.next(), None);
+///
+/// assert_eq!(FeatureFields::new(b"").next(), None);
+/// ```
+///
+/// It can be also created by [`Node::feature_fields()`].
+///
+/// ```no_run
+/// # use mecab_wrapper::Node;
+/// # fn test(node: &Node) {
+/// for field in node.feature_fields() {
+///     println!("{}", String::from_utf8_lossy(field));
+/// }
+/// # }
+/// ```
+#[derive(Debug, Clone)]
+pub struct FeatureFields<'a> {
+    rest: Option<&'a [u8]>,
+}
+
+impl<'a> FeatureFields<'a> {
+    /// Initializes with the given feature string.
+    #[inline]
+    pub fn new(feats: &'a [u8]) -> Self {
+        let rest = if feats.is_empty() { None } else { Some(feats) };
+        Self { rest }
+    }
+
+    /// Same as [`Self::new(node.features())`](Self::new()).
+    #[cfg(feature = "cmecab")]
+    #[inline]
+    pub fn from_node(node: &'a Node) -> Self {
+        Self::new(node.features())
+    }
+
+    /// The rest of the feature string this iterator has not split yet.
+    #[inline]
+    pub fn remainder(&self) -> &'a [u8] {
+        self.rest.unwrap_or_default()
+    }
+
+    /// Splits the rest at the first comma.
+    #[inline]
+    fn split_comma(&mut self, rest: &'a [u8]) -> &'a [u8] {
+        match find_byte(b',', rest) {
+            Some(i) => {
+                self.rest = Some(&rest[i + 1..]);
+                &rest[..i]
+            }
+            None => {
+                self.rest = None;
+                rest
+            }
+        }
+    }
+}
+
+impl<'a> Iterator for FeatureFields<'a> {
+    type Item = &'a [u8];
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let rest = self.rest?;
+        if rest.first() != Some(&b'"') {
+            return Some(self.split_comma(rest));
+        }
+
+        let body = &rest[1..];
+        let mut i = 0;
+        while let Some(q) = find_byte(b'"', &body[i..]) {
+            let q = i + q;
+            if body.get(q + 1) == Some(&b'"') {
+                i = q + 2;
+                continue;
+            }
+            // Ignore garbage between the closing quote and the next comma, as MeCab does.
+            self.split_comma(&body[q + 1..]);
+            return Some(&body[..q]);
+        }
+
+        // Unterminated quote.
+        self.rest = None;
+        Some(body)
+    }
+}
+
+impl<'a> std::iter::FusedIterator for FeatureFields<'a> {}
+
+/// Returns the `i`-th field of a feature string. It is the same as
+/// [`FeatureFields::new(feats).nth(i)`](FeatureFields).
+///
+/// ```
+/// use mecab_wrapper::feature_at;
+///
+/// assert_eq!(feature_at(b"a,b,c", 1), Some(&b"b"[..]));
+/// assert_eq!(feature_at(b"a,b,c", 3), None);
+/// ```
+#[inline]
+pub fn feature_at(feats: &[u8], i: usize) -> Option<&[u8]> {
+    FeatureFields::new(feats).nth(i)
+}
+
+/// Finds the first `needle` in `haystack`, comparing a word (eight bytes) at a time.
+#[inline]
+pub(crate) fn find_byte(needle: u8, haystack: &[u8]) -> Option<usize> {
+    const LO: u64 = u64::from_ne_bytes([0x01; 8]);
+    const HI: u64 = u64::from_ne_bytes([0x80; 8]);
+    let pattern = LO * needle as u64;
+
+    let mut chunks = haystack.chunks_exact(8);
+    let mut offset = 0;
+    for chunk in &mut chunks {
+        let word = u64::from_le_bytes(chunk.try_into().unwrap());
+        let x = word ^ pattern;
+        // The lowest set bit marks the first byte equal to `needle`.
+        let found = x.wrapping_sub(LO) & !x & HI;
+        if found != 0 {
+            return Some(offset + (found.trailing_zeros() / 8) as usize);
+        }
+        offset += 8;
+    }
+
+    let rest = chunks.remainder();
+    rest.iter().position(|&b| b == needle).map(|i| offset + i)
+}
+
 /// Represents a feature. This is created by [`Features`] or [`FeaturesIntoIter`](IntoIter).
 ///
 /// A `Feature` is a component of the features of each [`Node`](crate::Node).
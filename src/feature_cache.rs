@@ -0,0 +1,205 @@
+use crate::ffi::{Model, Node};
+use crate::FeatureFields;
+
+use std::collections::HashMap;
+use std::hash::{BuildHasherDefault, Hasher};
+use std::ops::Range;
+
+/// Opt-in cache of the split fields of [`Node::features()`], used by [`Node::cached_features()`].
+///
+/// For dictionary entries, MeCab returns feature pointers into the mmapped dictionary, which
+/// stay the same wherever the entries appear. `FeatureCache` keys on those pointers and stores
+/// the field offsets, so a repeated entry is split only once and a hit costs one hash lookup.
+///
+/// Whether a pointer is cached is decided by its address alone: [`FeatureCache::new()`] finds
+/// where the dictionaries of the model are mapped, and only features inside them are cached.
+/// Other features, e.g. allocated by the lattice from a feature constraint, whose addresses are
+/// reused by later parses, are split on every call. So are the features of new entries once
+/// [`MAX_ENTRIES`](FeatureCache::MAX_ENTRIES) are cached.
+///
+/// The mappings are those of the dictionary files of the model in this process, including the
+/// ones of other models loaded from the same files. Create a new cache for each
+/// [`Model`](crate::Model), and again when you [swap](crate::Model::swap()) the model, publish a
+/// new one in a [`SharedModel`](crate::SharedModel) or drop another model sharing its files.
+///
+/// ```no_run
+/// # use mecab_wrapper::{FeatureCache, Lattice, Model};
+/// # fn test(model: &Model, lattice: &Lattice<'_>) {
+/// let mut cache = FeatureCache::new(model);
+/// for node in lattice.iter_nodes() {
+///     let feats = node.cached_features(&mut cache);
+///     if feats.get(0) == Some("名詞".as_bytes()) {
+///         println!("{:?}", feats.get(6));
+///     }
+/// }
+/// # }
+/// ```
+#[derive(Debug)]
+pub struct FeatureCache {
+    /// Sorted address ranges of the dictionaries.
+    mapped: Vec<Range<usize>>,
+    index: HashMap<usize, Range<u32>, BuildHasherDefault<PtrHasher>>,
+    spans: Vec<Range<u32>>,
+    scratch: Vec<Range<u32>>,
+}
+
+impl FeatureCache {
+    /// The maximum number of cached feature pointers.
+    pub const MAX_ENTRIES: usize = 1 << 20;
+
+    /// An empty cache for the nodes of `model`.
+    ///
+    /// If the mappings cannot be read from `/proc/self/maps`, nothing is cached and every call
+    /// splits the features.
+    pub fn new(model: &Model) -> Self {
+        Self {
+            mapped: crate::registry::mapped_ranges(model).unwrap_or_default(),
+            index: HashMap::default(),
+            spans: Vec::new(),
+            scratch: Vec::new(),
+        }
+    }
+
+    /// The number of cached feature pointers.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.index.len()
+    }
+
+    /// Returns true if nothing is cached.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.index.is_empty()
+    }
+
+    /// Removes all the cached entries.
+    pub fn clear(&mut self) {
+        self.index.clear();
+        self.spans.clear();
+    }
+
+    /// Returns true if `feats` lies in a mapped dictionary.
+    fn is_mapped(&self, feats: &[u8]) -> bool {
+        let ptr = feats.as_ptr() as usize;
+        let i = self.mapped.partition_point(|r| r.start <= ptr);
+        i > 0 && ptr + feats.len() <= self.mapped[i - 1].end
+    }
+
+    fn lookup<'n>(&mut self, node: &'n Node) -> CachedFeatures<'n, '_> {
+        let feats = node.features();
+        let key = feats.as_ptr() as usize;
+
+        let spans = match self.index.get(&key) {
+            Some(spans) => Some(spans.clone()),
+            None if self.index.len() < Self::MAX_ENTRIES && self.is_mapped(feats) => {
+                let begin = self.spans.len() as u32;
+                push_spans(feats, &mut self.spans);
+                let spans = begin..self.spans.len() as u32;
+                self.index.insert(key, spans.clone());
+                Some(spans)
+            }
+            None => None,
+        };
+
+        let spans = match spans {
+            Some(spans) => &self.spans[spans.start as usize..spans.end as usize],
+            None => {
+                self.scratch.clear();
+                push_spans(feats, &mut self.scratch);
+                &self.scratch
+            }
+        };
+        CachedFeatures { feats, spans }
+    }
+}
+
+fn push_spans(feats: &[u8], spans: &mut Vec<Range<u32>>) {
+    let base = feats.as_ptr() as usize;
+    for field in FeatureFields::new(feats) {
+        let begin = (field.as_ptr() as usize - base) as u32;
+        spans.push(begin..begin + field.len() as u32);
+    }
+}
+
+/// Multiplicative hasher for pointer keys. SipHash is needlessly slow for them.
+#[derive(Debug, Default)]
+pub(crate) struct PtrHasher(u64);
+
+impl Hasher for PtrHasher {
+    #[inline]
+    fn finish(&self) -> u64 {
+        self.0
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.write_u64(b as u64);
+        }
+    }
+
+    #[inline]
+    fn write_u64(&mut self, n: u64) {
+        self.0 = (self.0.rotate_left(5) ^ n).wrapping_mul(0x51_7c_c1_b7_27_22_0a_95);
+    }
+
+    #[inline]
+    fn write_usize(&mut self, n: usize) {
+        self.write_u64(n as u64);
+    }
+}
+
+/// Pre-split fields of [`Node::features()`], returned by [`Node::cached_features()`].
+#[derive(Debug, Clone, Copy)]
+pub struct CachedFeatures<'n, 'c> {
+    feats: &'n [u8],
+    spans: &'c [Range<u32>],
+}
+
+impl<'n, 'c> CachedFeatures<'n, 'c> {
+    /// The whole feature string.
+    #[inline]
+    pub fn as_bytes(&self) -> &'n [u8] {
+        self.feats
+    }
+
+    /// The number of fields.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.spans.len()
+    }
+
+    /// Returns true if there are no fields.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.spans.is_empty()
+    }
+
+    /// Gets the `i`-th field in O(1). It returns `None` if the index is out-of-bound.
+    #[inline]
+    pub fn get(&self, i: usize) -> Option<&'n [u8]> {
+        let span = self.spans.get(i)?;
+        Some(&self.feats[span.start as usize..span.end as usize])
+    }
+
+    /// Returns an iterator of the fields.
+    pub fn iter(
+        &self,
+    ) -> impl Iterator<Item = &'n [u8]> + DoubleEndedIterator + ExactSizeIterator + '_ {
+        let feats = self.feats;
+        self.spans
+            .iter()
+            .map(move |span| &feats[span.start as usize..span.end as usize])
+    }
+}
+
+impl Node {
+    /// Returns the fields of [`Node::features()`], splitting them only on the first occurrence of
+    /// each dictionary entry. See [`FeatureCache`].
+    #[inline]
+    pub fn cached_features<'n, 'c>(
+        &'n self,
+        cache: &'c mut FeatureCache,
+    ) -> CachedFeatures<'n, 'c> {
+        cache.lookup(self)
+    }
+}
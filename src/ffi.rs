@@ -2,6 +2,9 @@ mod dictionary_info;
 pub use dictionary_info::DictionaryInfo;
 pub use dictionary_info::DictionaryType;
 
+mod connection_matrix;
+pub use connection_matrix::ConnectionMatrix;
+
 mod model_args;
 pub use model_args::ModelArgs;
 pub use model_args::OptionKey;
@@ -13,7 +16,9 @@ mod tagger;
 pub use tagger::Tagger;
 
 mod lattice;
+pub use lattice::Boundary;
 pub use lattice::Lattice;
+pub use lattice::LatticeStats;
 
 mod node;
 pub use node::Attribute;
@@ -21,9 +26,19 @@ pub use node::Node;
 pub use node::NodeStatus;
 pub use node::Path;
 
+mod lattice_graph;
+pub use lattice_graph::GraphEdge;
+pub use lattice_graph::GraphNode;
+pub use lattice_graph::LatticeGraph;
+
 mod request_type;
 pub use request_type::RequestType;
 
+mod token_buffer;
+pub use token_buffer::Token;
+pub use token_buffer::TokenBuffer;
+pub use token_buffer::Tokens;
+
 use libc::c_char;
 
 use std::ffi::CStr;
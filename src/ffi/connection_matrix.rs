@@ -0,0 +1,81 @@
+use super::Attribute;
+
+use libc::{c_short, c_ushort};
+
+/// Copy of the connection cost matrix of a [`Model`](crate::Model), created by
+/// [`Model::connection_matrix()`](crate::Model::connection_matrix()).
+///
+/// Looking up a cost is a plain array access, instead of an FFI call per pair as
+/// [`Model::transition_cost()`](crate::Model::transition_cost()), which makes rescoring lattices in
+/// Rust practical. The matrix is not updated when the model is [swapped](crate::Model::swap()).
+///
+/// ```no_run
+/// # use mecab_wrapper::{Model, Node};
+/// # fn test(model: &Model, left: &Node, right: &Node) {
+/// let matrix = model.connection_matrix();
+/// assert_eq!(
+///     matrix.cost(left.rattr, right.lattr) as i32,
+///     model.transition_cost(left.rattr, right.lattr),
+/// );
+/// # }
+/// ```
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ConnectionMatrix {
+    lsize: usize,
+    rsize: usize,
+    costs: Vec<c_short>,
+}
+
+impl ConnectionMatrix {
+    pub(crate) fn new(lsize: usize, rsize: usize, costs: Vec<c_short>) -> Self {
+        debug_assert_eq!(costs.len(), lsize * rsize);
+        Self {
+            lsize,
+            rsize,
+            costs,
+        }
+    }
+
+    /// The number of right attributes of the left nodes. See
+    /// [`DictionaryInfo::lsize`](crate::DictionaryInfo::lsize).
+    #[inline]
+    pub fn lsize(&self) -> usize {
+        self.lsize
+    }
+
+    /// The number of left attributes of the right nodes. See
+    /// [`DictionaryInfo::rsize`](crate::DictionaryInfo::rsize).
+    #[inline]
+    pub fn rsize(&self) -> usize {
+        self.rsize
+    }
+
+    /// The transition cost from a node with `rattr` to a node with `lattr`.
+    ///
+    /// # Panics
+    /// Panics if the attributes are out of the matrix.
+    #[inline]
+    pub fn cost(&self, rattr: Attribute, lattr: Attribute) -> c_short {
+        self.get(rattr.0, lattr.0)
+            .expect("attribute out of the matrix")
+    }
+
+    /// Same as [`ConnectionMatrix::cost()`] but with raw attribute IDs. It returns `None` if they
+    /// are out of the matrix.
+    #[inline]
+    pub fn get(&self, rattr: c_ushort, lattr: c_ushort) -> Option<c_short> {
+        let (r, l) = (rattr as usize, lattr as usize);
+        if r < self.lsize && l < self.rsize {
+            Some(self.costs[r + self.lsize * l])
+        } else {
+            None
+        }
+    }
+
+    /// The whole matrix. The cost from `rattr` to `lattr` is at `rattr + lsize() * lattr`, the same
+    /// layout as `matrix.bin`.
+    #[inline]
+    pub fn as_slice(&self) -> &[c_short] {
+        &self.costs
+    }
+}
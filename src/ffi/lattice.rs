@@ -1,6 +1,11 @@
+use super::lattice_graph::GraphSink;
+use super::token_buffer::TokenSink;
+use super::LatticeGraph;
 use super::Node;
 use super::RequestType;
-use crate::{NodeIter, NodeRevIter};
+use super::TokenBuffer;
+use crate::Metric;
+use crate::{BestTokens, NbestIter, NodeBnextIter, NodeEnextIter, NodeIter, NodeRevIter};
 
 use libc::{c_char, c_double, c_float, c_int, size_t};
 
@@ -39,8 +44,14 @@ extern "C" {
         size: size_t,
     ) -> *const c_char;
 
+    fn lattice_write(lattice: VoidPtr, sink: *mut ByteSink) -> bool;
+    fn nbest_write(lattice: VoidPtr, n: size_t, sink: *mut ByteSink) -> bool;
+    fn node_write(lattice: VoidPtr, node: *const c_void, sink: *mut ByteSink) -> bool;
+
     fn bos_node(lattice: VoidPtr) -> VoidPtr;
     fn eos_node(lattice: VoidPtr) -> VoidPtr;
+    fn lattice_begin_nodes(lattice: VoidPtr, pos: size_t) -> VoidPtr;
+    fn lattice_end_nodes(lattice: VoidPtr, pos: size_t) -> VoidPtr;
 
     fn next_lattice(lattice: VoidPtr) -> bool;
 
@@ -73,10 +84,76 @@ extern "C" {
 
     fn new_node(lattice: VoidPtr) -> VoidPtr;
 
+    fn lattice_stats(lattice: VoidPtr, stats: *mut LatticeStats);
+
+    fn export_tokens(lattice: VoidPtr, sink: *mut TokenSink) -> bool;
+    fn export_graph(lattice: VoidPtr, min_prob: c_float, sink: *mut GraphSink) -> bool;
+
     fn lattice_what(lattice: VoidPtr) -> *const c_char;
     fn set_lattice_what(lattice: VoidPtr, what: *const c_char);
 }
 
+/// Counters of a parsed lattice, returned by [`Lattice::stats()`]. It has the same layout as
+/// `lattice_stats_t` in `lib/cmecab.cpp`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct LatticeStats {
+    /// The number of candidate nodes including BOS/EOS.
+    pub nodes: usize,
+    /// The number of unknown-word candidate nodes.
+    pub unknown_nodes: usize,
+    /// The number of nodes on the best path including BOS/EOS.
+    pub best_path_nodes: usize,
+    /// The number of paths (edges). It is `0` unless
+    /// [`N_BEST`](RequestType::N_BEST) or [`MARGINAL_PROB`](RequestType::MARGINAL_PROB) is set.
+    pub paths: usize,
+    /// Estimated bytes for the nodes and paths.
+    pub bytes: usize,
+}
+
+/// A `Vec<u8>` handed to the C++ shims. It has the same layout as `byte_sink_t` in
+/// `lib/cmecab.cpp`.
+#[repr(C)]
+struct ByteSink {
+    ctx: *mut c_void,
+    reserve: extern "C" fn(sink: *mut ByteSink, size: size_t) -> bool,
+    ptr: *mut c_char,
+    len: size_t,
+    cap: size_t,
+}
+
+impl ByteSink {
+    fn new(buf: &mut Vec<u8>) -> Self {
+        Self {
+            ctx: buf as *mut Vec<u8> as _,
+            reserve: reserve_bytes,
+            ptr: buf.as_mut_ptr() as _,
+            len: buf.len(),
+            cap: buf.capacity(),
+        }
+    }
+
+    /// Writes `sink` into `buf` by `f`.
+    fn write<F: FnOnce(*mut ByteSink) -> bool>(buf: &mut Vec<u8>, f: F) -> bool {
+        let mut sink = Self::new(buf);
+        let ok = f(&mut sink);
+        unsafe { buf.set_len(sink.len) };
+        ok
+    }
+}
+
+extern "C" fn reserve_bytes(sink: *mut ByteSink, size: size_t) -> bool {
+    unsafe {
+        let sink = &mut *sink;
+        let buf = &mut *(sink.ctx as *mut Vec<u8>);
+        buf.set_len(sink.len);
+        buf.reserve(size);
+        sink.ptr = buf.as_mut_ptr() as _;
+        sink.cap = buf.capacity();
+    }
+    true
+}
+
 pub enum Boundary {
     /// The token boundary is not specified.
     NotSpecified,
@@ -91,6 +168,10 @@ pub struct Lattice<'a> {
     phantom: PhantomData<&'a ()>,
 }
 
+// A lattice has no thread affinity, but methods taking `&self` such as `to_bytes()` write into its
+// internal buffer, so it is not `Sync`.
+unsafe impl Send for Lattice<'_> {}
+
 impl Default for Lattice<'_> {
     #[inline]
     fn default() -> Self {
@@ -123,8 +204,17 @@ impl<'a> Lattice<'a> {
     }
 
     pub fn sentence(&mut self) -> &[u8] {
+        self.sentence_ref()
+    }
+
+    /// Same as [`Lattice::sentence()`], through a shared reference for the crate-internal users
+    /// which also hold nodes.
+    pub(crate) fn sentence_ref(&self) -> &[u8] {
         unsafe {
             let s = lattice_sentence(self.void_lattice);
+            if s.is_null() {
+                return &[];
+            }
             std::slice::from_raw_parts(s as _, self.sentence_len())
         }
     }
@@ -140,14 +230,22 @@ impl<'a> Lattice<'a> {
     }
 
     pub fn set_sentence(&mut self, sentence: &str) {
+        self.set_sentence_bytes(sentence.as_bytes());
+    }
+
+    /// Same as [`Lattice::set_sentence()`], for a sentence in the charset of the dictionary which
+    /// is not necessarily UTF-8.
+    pub fn set_sentence_bytes(&mut self, sentence: &[u8]) {
         let ptr = sentence.as_ptr();
         let len = sentence.len();
-        unsafe { set_sentence(self.void_lattice, ptr as _, len as _) }
+        crate::metrics::timed(Metric::SetSentence, || unsafe {
+            set_sentence(self.void_lattice, ptr as _, len as _)
+        })
     }
 
     pub fn to_bytes(&self) -> &[u8] {
         unsafe {
-            let s = lattice_to_string(self.void_lattice);
+            let s = crate::metrics::timed(Metric::Render, || lattice_to_string(self.void_lattice));
             let s = CStr::from_ptr(s);
             s.to_bytes()
         }
@@ -165,13 +263,45 @@ impl<'a> Lattice<'a> {
     /// This method is unsafe because MeCab internally deletes `buf` and re-allocates new buffer.
     /// So, use this method *only if* you are sure i) which allocator MeCab uses and ii) by which
     /// allocator a `buf` is created.
+    ///
+    /// Use [`Lattice::write_to()`] for a safe alternative.
     pub unsafe fn to_bytes_buffer(&self, buf: &mut Vec<u8>) {
         lattice_to_string_alloc(self.void_lattice, buf.as_mut_ptr() as _, buf.len());
     }
 
+    /// Appends the same string as [`Lattice::to_bytes()`] to `buf`.
+    ///
+    /// MeCab renders directly into the spare capacity of `buf`. Only if it does not fit, the
+    /// string is rendered into the lattice's internal buffer and copied, and `buf` grows so that
+    /// the next call fits. Thus clearing and reusing one `buf` for every sentence does not allocate
+    /// in the steady state.
+    ///
+    /// Returns false if MeCab cannot render the lattice.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Lattice, Tagger};
+    /// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>, inputs: &[&str]) {
+    /// let mut out = Vec::with_capacity(4096);
+    /// for input in inputs {
+    ///     lattice.set_sentence(input);
+    ///     if tagger.parse(lattice) {
+    ///         out.clear();
+    ///         lattice.write_to(&mut out);
+    ///     }
+    /// }
+    /// # }
+    /// ```
+    pub fn write_to(&self, buf: &mut Vec<u8>) -> bool {
+        crate::metrics::timed(Metric::Render, || {
+            ByteSink::write(buf, |sink| unsafe {
+                lattice_write(self.void_lattice, sink)
+            })
+        })
+    }
+
     pub fn nbest_to_bytes(&self, n: usize) -> &[u8] {
         unsafe {
-            let s = nbest_string(self.void_lattice, n);
+            let s = crate::metrics::timed(Metric::Render, || nbest_string(self.void_lattice, n));
             let s = CStr::from_ptr(s);
             s.to_bytes()
         }
@@ -189,10 +319,25 @@ impl<'a> Lattice<'a> {
     /// This method is unsafe because MeCab internally deletes `buf` and re-allocates new buffer.
     /// So, use this method *only if* you are sure i) which allocator MeCab uses and ii) by which
     /// allocator a `buf` is created.
+    ///
+    /// Use [`Lattice::nbest_write_to()`] for a safe alternative.
     pub unsafe fn nbest_to_bytes_buffer(&self, n: usize, buf: &mut Vec<u8>) {
         nbest_string_alloc(self.void_lattice, n, buf.as_mut_ptr() as _, buf.len());
     }
 
+    /// Appends the same string as [`Lattice::nbest_to_bytes()`] to `buf`.
+    ///
+    /// Unlike [`Lattice::write_to()`], the string is always rendered into the lattice's internal
+    /// buffer and copied: rendering the N-best paths advances the N-best enumeration, so a
+    /// rendering into `buf` that does not fit cannot be retried.
+    pub fn nbest_write_to(&self, n: usize, buf: &mut Vec<u8>) -> bool {
+        crate::metrics::timed(Metric::Render, || {
+            ByteSink::write(buf, |sink| unsafe {
+                nbest_write(self.void_lattice, n, sink)
+            })
+        })
+    }
+
     pub fn node_to_bytes<'b>(&'b self, node: &'b Node) -> &[u8] {
         unsafe {
             let s = node_string(self.void_lattice, node as *const Node as _);
@@ -213,6 +358,8 @@ impl<'a> Lattice<'a> {
     /// This method is unsafe because MeCab internally deletes `buf` and re-allocates new buffer.
     /// So, use this method *only if* you are sure i) which allocator MeCab uses and ii) by which
     /// allocator a `buf` is created.
+    ///
+    /// Use [`Lattice::node_write_to()`] for a safe alternative.
     pub unsafe fn node_to_bytes_buffer<'b>(&'b self, node: &'b Node, buf: &mut Vec<u8>) {
         node_string_alloc(
             self.void_lattice,
@@ -222,6 +369,15 @@ impl<'a> Lattice<'a> {
         );
     }
 
+    /// Appends the same string as [`Lattice::node_to_bytes()`] to `buf`. See
+    /// [`Lattice::write_to()`].
+    pub fn node_write_to<'b>(&'b self, node: &'b Node, buf: &mut Vec<u8>) -> bool {
+        let node = node as *const Node as _;
+        ByteSink::write(buf, |sink| unsafe {
+            node_write(self.void_lattice, node, sink)
+        })
+    }
+
     pub fn bos_node(&self) -> Option<&Node> {
         unsafe {
             let node = bos_node(self.void_lattice);
@@ -235,6 +391,42 @@ impl<'a> Lattice<'a> {
         }
     }
 
+    /// The first of the nodes beginning at byte `pos` of the sentence, in O(1). The others
+    /// follow by [`Node::bnext()`].
+    ///
+    /// It returns `None` if no node begins at `pos`, `pos` is larger than the sentence length, or
+    /// the lattice is not parsed. EOS begins at the sentence length.
+    pub fn begin_nodes(&self, pos: usize) -> Option<&Node> {
+        unsafe {
+            let node = lattice_begin_nodes(self.void_lattice, pos);
+            (node as *const Node).as_ref()
+        }
+    }
+
+    /// The first of the nodes ending at byte `pos` of the sentence, in O(1). The others follow by
+    /// [`Node::enext()`].
+    ///
+    /// It returns `None` if no node ends at `pos`, `pos` is larger than the sentence length, or
+    /// the lattice is not parsed. BOS ends at `0`.
+    pub fn end_nodes(&self, pos: usize) -> Option<&Node> {
+        unsafe {
+            let node = lattice_end_nodes(self.void_lattice, pos);
+            (node as *const Node).as_ref()
+        }
+    }
+
+    /// Iterates all the candidate nodes beginning at byte `pos`. See [`Lattice::begin_nodes()`].
+    #[inline]
+    pub fn nodes_at(&self, pos: usize) -> NodeBnextIter<'_> {
+        NodeBnextIter::from_node_option(self.begin_nodes(pos))
+    }
+
+    /// Iterates all the candidate nodes ending at byte `pos`. See [`Lattice::end_nodes()`].
+    #[inline]
+    pub fn nodes_ending_at(&self, pos: usize) -> NodeEnextIter<'_> {
+        NodeEnextIter::from_node_option(self.end_nodes(pos))
+    }
+
     #[inline]
     pub fn iter_nodes(&self) -> NodeIter<'_> {
         NodeIter::from_bos(self)
@@ -245,6 +437,79 @@ impl<'a> Lattice<'a> {
         NodeRevIter::from_eos(self)
     }
 
+    /// Same as `self.iter_nodes().best_tokens()`. See [`BestTokens`].
+    #[inline]
+    pub fn best_tokens(&self) -> BestTokens<'_> {
+        self.iter_nodes().best_tokens()
+    }
+
+    /// Same as [`NbestIter::new(self)`](NbestIter::new()).
+    #[inline]
+    pub fn iter_nbest(&mut self) -> NbestIter<'_, 'a> {
+        NbestIter::new(self)
+    }
+
+    /// Stores the best path into `tokens` as one sentence, walking the nodes only once.
+    ///
+    /// `tokens` is cleared first. Surface ranges of the tokens are relative to
+    /// [`Lattice::sentence()`]. Since `tokens` keeps its allocations, reusing one buffer for every
+    /// sentence does not allocate once it has grown large enough.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Lattice, Tagger, TokenBuffer};
+    /// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>, inputs: &[&str]) {
+    /// let mut tokens = TokenBuffer::new();
+    /// for input in inputs {
+    ///     lattice.set_sentence(input);
+    ///     if tagger.parse(lattice) {
+    ///         lattice.export_tokens(&mut tokens);
+    ///         for (begin, posid) in tokens.begins().iter().zip(tokens.posids()) {
+    ///             println!("{begin} {posid}");
+    ///         }
+    ///     }
+    /// }
+    /// # }
+    /// ```
+    pub fn export_tokens(&self, tokens: &mut TokenBuffer) {
+        tokens.clear();
+        let mut sink = tokens.sink(1);
+        unsafe {
+            crate::metrics::timed(Metric::Export, || {
+                export_tokens(self.void_lattice, &mut sink)
+            });
+            tokens.commit(&sink);
+        }
+    }
+
+    /// Stores every candidate node and edge of the lattice into `graph` in one call. See
+    /// [`LatticeGraph`].
+    ///
+    /// Nodes other than BOS/EOS, and edges, whose marginal probability is less than `min_prob`
+    /// are left out, as well as the edges from the nodes left out. Pass `0.0` to keep everything.
+    /// The probabilities are meaningful only if the lattice is parsed with
+    /// [`RequestType::MARGINAL_PROB`].
+    ///
+    /// Returns false (and `graph` is empty) if the lattice is not parsed.
+    pub fn export_graph(&self, graph: &mut LatticeGraph, min_prob: f32) -> bool {
+        let mut sink = graph.sink();
+        unsafe {
+            let ok = crate::metrics::timed(Metric::Export, || {
+                export_graph(self.void_lattice, min_prob, &mut sink)
+            });
+            graph.commit(&sink);
+            ok
+        }
+    }
+
+    /// Counts the nodes of the lattice in one call. All the counts are `0` if it is not parsed.
+    pub fn stats(&self) -> LatticeStats {
+        let mut stats = LatticeStats::default();
+        unsafe {
+            lattice_stats(self.void_lattice, &mut stats);
+        }
+        stats
+    }
+
     pub fn get_request_type(&mut self) -> RequestType {
         unsafe {
             let req = get_request_type(self.void_lattice);
@@ -329,11 +594,15 @@ impl<'a> Lattice<'a> {
         }
     }
 
+    /// The feature constraint of the token beginning at `pos`, or an empty slice if there is
+    /// none. MeCab returns a null pointer for the positions without a feature constraint.
     pub fn feature_constraint(&self, pos: usize) -> &[u8] {
         unsafe {
             let features = lattice_feature_constraint(self.void_lattice, pos);
-            let features = CStr::from_ptr(features);
-            features.to_bytes()
+            if features.is_null() {
+                return &[];
+            }
+            CStr::from_ptr(features).to_bytes()
         }
     }
 
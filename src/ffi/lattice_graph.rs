@@ -0,0 +1,498 @@
+use super::{Attribute, NodeStatus};
+
+use libc::{c_float, c_int, c_long, c_short, c_uchar, c_ushort, size_t};
+
+use libc::c_void;
+
+use std::ops::Range;
+
+/// Column pointers handed to the C++ shims. It has the same layout as `graph_sink_t` in
+/// `lib/cmecab.cpp`.
+#[repr(C)]
+pub(crate) struct GraphSink {
+    ctx: *mut c_void,
+    reserve: extern "C" fn(sink: *mut GraphSink, nodes: size_t, edges: size_t) -> bool,
+
+    nodes_len: size_t,
+    nodes_cap: size_t,
+    begin: *mut size_t,
+    length: *mut c_ushort,
+    posid: *mut c_ushort,
+    rattr: *mut c_ushort,
+    lattr: *mut c_ushort,
+    wcost: *mut c_short,
+    cost: *mut c_long,
+    stat: *mut c_uchar,
+    alpha: *mut c_float,
+    beta: *mut c_float,
+    prob: *mut c_float,
+    edge_end: *mut size_t,
+
+    edges_len: size_t,
+    edges_cap: size_t,
+    lnode: *mut size_t,
+    edge_cost: *mut c_int,
+    edge_prob: *mut c_float,
+}
+
+extern "C" fn reserve_graph(sink: *mut GraphSink, nodes: size_t, edges: size_t) -> bool {
+    unsafe {
+        let sink = &mut *sink;
+        let graph = &mut *(sink.ctx as *mut LatticeGraph);
+        graph.reserve(nodes, edges);
+        graph.refresh(sink);
+    }
+    true
+}
+
+/// The whole lattice of a parsed sentence, flattened into contiguous arrays.
+///
+/// Unlike [`TokenBuffer`](crate::TokenBuffer), which holds only the best path, a `LatticeGraph`
+/// holds every candidate node and the incoming edges ([`Node::lpath()`](crate::Node::lpath())) of
+/// each node, with the values computed by
+/// [`MARGINAL_PROB`](crate::RequestType::MARGINAL_PROB): [`Node::alpha`](crate::Node::alpha),
+/// [`Node::beta`](crate::Node::beta), [`Node::prob`](crate::Node::prob) and
+/// [`Path::prob`](crate::Path::prob). It is filled by
+/// [`Lattice::export_graph()`](crate::Lattice::export_graph()) in one call, and does not borrow
+/// the lattice.
+///
+/// Nodes are in topological order: the first node is BOS, the last one is EOS, and the others are
+/// sorted by the begin position. Edges always go from a lower index to a higher one.
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, LatticeGraph, RequestType, Tagger};
+/// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>) {
+/// lattice.set_request_type(RequestType::MARGINAL_PROB);
+/// lattice.set_sentence("すもももももももものうち");
+/// tagger.parse(lattice);
+///
+/// let mut graph = LatticeGraph::new();
+/// lattice.export_graph(&mut graph, 0.01);
+/// for node in graph.nodes() {
+///     let sentence = lattice.sentence();
+///     println!("{:?} {}", &sentence[node.surface_range()], node.prob());
+///     for edge in node.edges() {
+///         println!("  from {} (cost {}, prob {})", edge.lnode, edge.cost, edge.prob);
+///     }
+/// }
+/// # }
+/// ```
+#[derive(Debug, Default, Clone)]
+pub struct LatticeGraph {
+    begins: Vec<usize>,
+    lengths: Vec<c_ushort>,
+    posids: Vec<c_ushort>,
+    rattrs: Vec<Attribute>,
+    lattrs: Vec<Attribute>,
+    wcosts: Vec<c_short>,
+    costs: Vec<c_long>,
+    stats: Vec<c_uchar>,
+    alphas: Vec<c_float>,
+    betas: Vec<c_float>,
+    probs: Vec<c_float>,
+    edge_ends: Vec<usize>,
+
+    lnodes: Vec<usize>,
+    edge_costs: Vec<c_int>,
+    edge_probs: Vec<c_float>,
+}
+
+impl LatticeGraph {
+    #[inline]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Removes all the nodes and edges, keeping the allocated memory.
+    pub fn clear(&mut self) {
+        self.begins.clear();
+        self.lengths.clear();
+        self.posids.clear();
+        self.rattrs.clear();
+        self.lattrs.clear();
+        self.wcosts.clear();
+        self.costs.clear();
+        self.stats.clear();
+        self.alphas.clear();
+        self.betas.clear();
+        self.probs.clear();
+        self.edge_ends.clear();
+        self.lnodes.clear();
+        self.edge_costs.clear();
+        self.edge_probs.clear();
+    }
+
+    /// The number of nodes including BOS and EOS.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.begins.len()
+    }
+
+    /// Returns true if `self` has no nodes.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.begins.is_empty()
+    }
+
+    /// The number of edges.
+    #[inline]
+    pub fn edge_count(&self) -> usize {
+        self.lnodes.len()
+    }
+
+    /// Gets the `i`-th node. It returns `None` if the index is out-of-bound.
+    pub fn get(&self, i: usize) -> Option<GraphNode<'_>> {
+        if i < self.len() {
+            Some(GraphNode {
+                graph: self,
+                index: i,
+            })
+        } else {
+            None
+        }
+    }
+
+    /// BOS node. It returns `None` if `self` is empty.
+    #[inline]
+    pub fn bos(&self) -> Option<GraphNode<'_>> {
+        self.get(0)
+    }
+
+    /// EOS node. It returns `None` if `self` is empty.
+    #[inline]
+    pub fn eos(&self) -> Option<GraphNode<'_>> {
+        self.get(self.len().wrapping_sub(1))
+    }
+
+    /// Returns an iterator of all the nodes in topological order.
+    pub fn nodes(
+        &self,
+    ) -> impl Iterator<Item = GraphNode<'_>> + DoubleEndedIterator + ExactSizeIterator {
+        (0..self.len()).map(|index| GraphNode { graph: self, index })
+    }
+
+    /// Range of the edge indices of the incoming edges of the `i`-th node.
+    ///
+    /// # Panics
+    /// Panics if `i >= self.len()`.
+    #[inline]
+    pub fn edge_range(&self, i: usize) -> Range<usize> {
+        let end = self.edge_ends[i];
+        let begin = if i == 0 { 0 } else { self.edge_ends[i - 1] };
+        begin..end
+    }
+
+    /// Gets the `e`-th edge. It returns `None` if the index is out-of-bound.
+    #[inline]
+    pub fn edge(&self, e: usize) -> Option<GraphEdge> {
+        Some(GraphEdge {
+            lnode: *self.lnodes.get(e)?,
+            cost: self.edge_costs[e],
+            prob: self.edge_probs[e],
+        })
+    }
+
+    /// Begin offsets of the surface strings in the parsed sentence.
+    #[inline]
+    pub fn begins(&self) -> &[usize] {
+        &self.begins
+    }
+
+    /// See [`Node::length`](crate::Node::length).
+    #[inline]
+    pub fn lengths(&self) -> &[c_ushort] {
+        &self.lengths
+    }
+
+    /// See [`Node::posid`](crate::Node::posid).
+    #[inline]
+    pub fn posids(&self) -> &[c_ushort] {
+        &self.posids
+    }
+
+    /// See [`Node::rattr`](crate::Node::rattr).
+    #[inline]
+    pub fn rattrs(&self) -> &[Attribute] {
+        &self.rattrs
+    }
+
+    /// See [`Node::lattr`](crate::Node::lattr).
+    #[inline]
+    pub fn lattrs(&self) -> &[Attribute] {
+        &self.lattrs
+    }
+
+    /// See [`Node::wcost`](crate::Node::wcost).
+    #[inline]
+    pub fn wcosts(&self) -> &[c_short] {
+        &self.wcosts
+    }
+
+    /// See [`Node::cost`](crate::Node::cost).
+    #[inline]
+    pub fn costs(&self) -> &[c_long] {
+        &self.costs
+    }
+
+    /// Raw values of `MeCab::Node::stat`. Use [`GraphNode::status()`] to get [`NodeStatus`].
+    #[inline]
+    pub fn stats(&self) -> &[c_uchar] {
+        &self.stats
+    }
+
+    /// See [`Node::alpha`](crate::Node::alpha).
+    #[inline]
+    pub fn alphas(&self) -> &[c_float] {
+        &self.alphas
+    }
+
+    /// See [`Node::beta`](crate::Node::beta).
+    #[inline]
+    pub fn betas(&self) -> &[c_float] {
+        &self.betas
+    }
+
+    /// See [`Node::prob`](crate::Node::prob).
+    #[inline]
+    pub fn probs(&self) -> &[c_float] {
+        &self.probs
+    }
+
+    /// End indices of the incoming edges of each node. See also [`LatticeGraph::edge_range()`].
+    #[inline]
+    pub fn edge_ends(&self) -> &[usize] {
+        &self.edge_ends
+    }
+
+    /// Node indices of the left end of each edge.
+    #[inline]
+    pub fn lnodes(&self) -> &[usize] {
+        &self.lnodes
+    }
+
+    /// See [`Path::cost`](crate::Path::cost).
+    #[inline]
+    pub fn edge_costs(&self) -> &[c_int] {
+        &self.edge_costs
+    }
+
+    /// See [`Path::prob`](crate::Path::prob).
+    #[inline]
+    pub fn edge_probs(&self) -> &[c_float] {
+        &self.edge_probs
+    }
+
+    fn reserve(&mut self, nodes: usize, edges: usize) {
+        let nodes = nodes.saturating_sub(self.len());
+        self.begins.reserve(nodes);
+        self.lengths.reserve(nodes);
+        self.posids.reserve(nodes);
+        self.rattrs.reserve(nodes);
+        self.lattrs.reserve(nodes);
+        self.wcosts.reserve(nodes);
+        self.costs.reserve(nodes);
+        self.stats.reserve(nodes);
+        self.alphas.reserve(nodes);
+        self.betas.reserve(nodes);
+        self.probs.reserve(nodes);
+        self.edge_ends.reserve(nodes);
+
+        let edges = edges.saturating_sub(self.edge_count());
+        self.lnodes.reserve(edges);
+        self.edge_costs.reserve(edges);
+        self.edge_probs.reserve(edges);
+    }
+
+    fn refresh(&mut self, sink: &mut GraphSink) {
+        sink.nodes_len = self.len();
+        sink.nodes_cap = [
+            self.begins.capacity(),
+            self.lengths.capacity(),
+            self.posids.capacity(),
+            self.rattrs.capacity(),
+            self.lattrs.capacity(),
+            self.wcosts.capacity(),
+            self.costs.capacity(),
+            self.stats.capacity(),
+            self.alphas.capacity(),
+            self.betas.capacity(),
+            self.probs.capacity(),
+            self.edge_ends.capacity(),
+        ]
+        .into_iter()
+        .min()
+        .unwrap();
+        sink.begin = self.begins.as_mut_ptr();
+        sink.length = self.lengths.as_mut_ptr();
+        sink.posid = self.posids.as_mut_ptr();
+        sink.rattr = self.rattrs.as_mut_ptr() as _;
+        sink.lattr = self.lattrs.as_mut_ptr() as _;
+        sink.wcost = self.wcosts.as_mut_ptr();
+        sink.cost = self.costs.as_mut_ptr();
+        sink.stat = self.stats.as_mut_ptr();
+        sink.alpha = self.alphas.as_mut_ptr();
+        sink.beta = self.betas.as_mut_ptr();
+        sink.prob = self.probs.as_mut_ptr();
+        sink.edge_end = self.edge_ends.as_mut_ptr();
+
+        sink.edges_len = self.edge_count();
+        sink.edges_cap = [
+            self.lnodes.capacity(),
+            self.edge_costs.capacity(),
+            self.edge_probs.capacity(),
+        ]
+        .into_iter()
+        .min()
+        .unwrap();
+        sink.lnode = self.lnodes.as_mut_ptr();
+        sink.edge_cost = self.edge_costs.as_mut_ptr();
+        sink.edge_prob = self.edge_probs.as_mut_ptr();
+    }
+
+    /// Clears `self` and returns column pointers to it.
+    ///
+    /// The returned sink must be passed to [`LatticeGraph::commit()`] after the C++ side has
+    /// filled it, and `self` must not be touched in between.
+    pub(crate) fn sink(&mut self) -> GraphSink {
+        self.clear();
+        let mut sink = GraphSink {
+            ctx: self as *mut Self as _,
+            reserve: reserve_graph,
+            nodes_len: 0,
+            nodes_cap: 0,
+            begin: std::ptr::null_mut(),
+            length: std::ptr::null_mut(),
+            posid: std::ptr::null_mut(),
+            rattr: std::ptr::null_mut(),
+            lattr: std::ptr::null_mut(),
+            wcost: std::ptr::null_mut(),
+            cost: std::ptr::null_mut(),
+            stat: std::ptr::null_mut(),
+            alpha: std::ptr::null_mut(),
+            beta: std::ptr::null_mut(),
+            prob: std::ptr::null_mut(),
+            edge_end: std::ptr::null_mut(),
+            edges_len: 0,
+            edges_cap: 0,
+            lnode: std::ptr::null_mut(),
+            edge_cost: std::ptr::null_mut(),
+            edge_prob: std::ptr::null_mut(),
+        };
+        self.refresh(&mut sink);
+        sink
+    }
+
+    /// Takes in the elements written through `sink`.
+    ///
+    /// # Safety
+    /// `sink` must be returned by [`LatticeGraph::sink()`] of `self`, and the C++ side must have
+    /// initialized every element below the lengths it reports.
+    pub(crate) unsafe fn commit(&mut self, sink: &GraphSink) {
+        let len = sink.nodes_len;
+        self.begins.set_len(len);
+        self.lengths.set_len(len);
+        self.posids.set_len(len);
+        self.rattrs.set_len(len);
+        self.lattrs.set_len(len);
+        self.wcosts.set_len(len);
+        self.costs.set_len(len);
+        self.stats.set_len(len);
+        self.alphas.set_len(len);
+        self.betas.set_len(len);
+        self.probs.set_len(len);
+        self.edge_ends.set_len(len);
+
+        let len = sink.edges_len;
+        self.lnodes.set_len(len);
+        self.edge_costs.set_len(len);
+        self.edge_probs.set_len(len);
+    }
+}
+
+/// Incoming edge of a [`GraphNode`]. See [`Path`](crate::Path).
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct GraphEdge {
+    /// Index of the left node.
+    pub lnode: usize,
+    /// Local cost. See [`Path::cost`](crate::Path::cost).
+    pub cost: c_int,
+    /// Marginal probability. See [`Path::prob`](crate::Path::prob).
+    pub prob: c_float,
+}
+
+/// A node in a [`LatticeGraph`].
+#[derive(Debug, Clone, Copy)]
+pub struct GraphNode<'a> {
+    graph: &'a LatticeGraph,
+    index: usize,
+}
+
+impl<'a> GraphNode<'a> {
+    /// Index of `self` in the graph.
+    #[inline]
+    pub fn index(self) -> usize {
+        self.index
+    }
+
+    /// Byte range of the surface string in the parsed sentence.
+    #[inline]
+    pub fn surface_range(self) -> Range<usize> {
+        let begin = self.graph.begins[self.index];
+        begin..begin + self.graph.lengths[self.index] as usize
+    }
+
+    #[inline]
+    pub fn posid(self) -> c_ushort {
+        self.graph.posids[self.index]
+    }
+
+    #[inline]
+    pub fn rattr(self) -> Attribute {
+        self.graph.rattrs[self.index]
+    }
+
+    #[inline]
+    pub fn lattr(self) -> Attribute {
+        self.graph.lattrs[self.index]
+    }
+
+    #[inline]
+    pub fn wcost(self) -> c_short {
+        self.graph.wcosts[self.index]
+    }
+
+    #[inline]
+    pub fn cost(self) -> c_long {
+        self.graph.costs[self.index]
+    }
+
+    #[inline]
+    pub fn status(self) -> NodeStatus {
+        NodeStatus::from_stat(self.graph.stats[self.index])
+    }
+
+    #[inline]
+    pub fn alpha(self) -> c_float {
+        self.graph.alphas[self.index]
+    }
+
+    #[inline]
+    pub fn beta(self) -> c_float {
+        self.graph.betas[self.index]
+    }
+
+    #[inline]
+    pub fn prob(self) -> c_float {
+        self.graph.probs[self.index]
+    }
+
+    /// Returns an iterator of the incoming edges.
+    pub fn edges(
+        self,
+    ) -> impl Iterator<Item = GraphEdge> + DoubleEndedIterator + ExactSizeIterator + 'a {
+        let graph = self.graph;
+        graph
+            .edge_range(self.index)
+            .map(move |e| graph.edge(e).unwrap())
+    }
+}
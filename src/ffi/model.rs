@@ -1,6 +1,10 @@
-use super::{Attribute, DictionaryInfo, Lattice, ModelArgs, Node, Tagger};
+use super::token_buffer::TokenSink;
+use super::{
+    Attribute, ConnectionMatrix, DictionaryInfo, Lattice, ModelArgs, Node, Tagger, TokenBuffer,
+};
+use crate::{PosInterner, PrefixMatches};
 
-use libc::{c_char, c_int, c_ushort};
+use libc::{c_char, c_int, c_short, c_ushort, size_t};
 
 use libc::c_void;
 type VoidPtr = *mut c_void;
@@ -8,6 +12,7 @@ type VoidPtr = *mut c_void;
 use std::ffi::CStr;
 use std::ptr::NonNull;
 use std::str::Utf8Error;
+use std::sync::OnceLock;
 
 #[link(name = "cmecab")]
 extern "C" {
@@ -17,6 +22,14 @@ extern "C" {
     fn model_version() -> *const c_char;
 
     fn transition_cost(model: VoidPtr, rattr: c_ushort, lattr: c_ushort) -> c_int;
+    fn fill_connection_matrix(model: VoidPtr, out: *mut c_short);
+    fn transition_costs(
+        model: VoidPtr,
+        rattrs: *const c_ushort,
+        lattrs: *const c_ushort,
+        n: size_t,
+        out: *mut c_int,
+    ) -> size_t;
 
     fn swap_model(model: VoidPtr, new_model: VoidPtr) -> bool;
 
@@ -29,12 +42,28 @@ extern "C" {
         end: *const c_char,
         lattice: VoidPtr,
     ) -> VoidPtr;
+    fn lookup_batch(
+        model: VoidPtr,
+        lattice: VoidPtr,
+        inputs: *const *const c_char,
+        lens: *const size_t,
+        n: size_t,
+        sink: *mut TokenSink,
+    ) -> size_t;
+    fn lookup_suffixes(
+        model: VoidPtr,
+        lattice: VoidPtr,
+        text: *const c_char,
+        len: size_t,
+        sink: *mut TokenSink,
+    ) -> bool;
 }
 
 /// Wrapper of the
 /// [`MeCab::Model`](https://taku910.github.io/mecab/doxygen/classMeCab_1_1Model.html) class.
 pub struct Model {
     void_model: NonNull<c_void>,
+    pub(crate) pos_interner: OnceLock<PosInterner>,
 }
 
 unsafe impl Send for Model {}
@@ -52,7 +81,10 @@ impl Model {
     pub fn new<Arg: ModelArgs>(arg: Arg) -> Option<Self> {
         let void_model = arg.create_model();
         let void_model = NonNull::new(void_model)?;
-        Some(Self { void_model })
+        Some(Self {
+            void_model,
+            pos_interner: OnceLock::new(),
+        })
     }
 
     /// Dictionary information.
@@ -82,6 +114,49 @@ impl Model {
         unsafe { transition_cost(self.void_model.as_ptr(), rattr.0, lattr.0) }
     }
 
+    /// Copies the whole connection cost matrix in one call. See [`ConnectionMatrix`].
+    pub fn connection_matrix(&self) -> ConnectionMatrix {
+        let info = self.dictionary_info();
+        let (lsize, rsize) = (info.lsize as usize, info.rsize as usize);
+        let mut costs = Vec::with_capacity(lsize * rsize);
+        unsafe {
+            fill_connection_matrix(self.void_model.as_ptr(), costs.as_mut_ptr());
+            costs.set_len(lsize * rsize);
+        }
+        ConnectionMatrix::new(lsize, rsize, costs)
+    }
+
+    /// Evaluates [`Model::transition_cost()`] for each pair `(rattrs[i], lattrs[i])` in one call,
+    /// and stores the costs into `out`, which is cleared first.
+    ///
+    /// Returns false if some attribute is out of the matrix; then `out` has the costs before that
+    /// pair.
+    ///
+    /// # Panics
+    /// Panics if `rattrs` and `lattrs` have different lengths.
+    pub fn transition_costs(
+        &self,
+        rattrs: &[Attribute],
+        lattrs: &[Attribute],
+        out: &mut Vec<c_int>,
+    ) -> bool {
+        assert_eq!(rattrs.len(), lattrs.len());
+        let n = rattrs.len();
+        out.clear();
+        out.reserve(n);
+        unsafe {
+            let len = transition_costs(
+                self.void_model.as_ptr(),
+                rattrs.as_ptr() as _,
+                lattrs.as_ptr() as _,
+                n,
+                out.as_mut_ptr(),
+            );
+            out.set_len(len);
+            len == n
+        }
+    }
+
     /// Swaps the instance with `new_model`.
     ///
     /// Returns true if the model is swapped successfully.
@@ -90,7 +165,11 @@ impl Model {
     /// updated asynchronously. No need to stop the parsing thread explicitly before swapping model
     /// objects.
     pub fn swap(&mut self, new_model: Self) -> bool {
-        unsafe { swap_model(self.void_model.as_ptr(), new_model.void_model.as_ptr()) }
+        let ok = unsafe { swap_model(self.void_model.as_ptr(), new_model.void_model.as_ptr()) };
+        if ok {
+            self.pos_interner = OnceLock::new();
+        }
+        ok
     }
 
     /// Creates a new tagger object. Equivalent to `MeCab::Model::createTagger()`.
@@ -133,6 +212,116 @@ impl Model {
             (node as *const Node).as_ref()
         }
     }
+
+    /// Iterates all the matches of [`Model::prefix_search()`], i.e., the dictionary entries which
+    /// are prefixes of `prefix`. When nothing matches, MeCab returns unknown word nodes instead.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::Model;
+    /// # fn test(model: &Model) {
+    /// let mut lattice = model.create_lattice();
+    /// for node in model.prefix_matches("東京都庁", &mut lattice) {
+    ///     println!("{:?}", node.surface_str());
+    /// }
+    /// # }
+    /// ```
+    #[inline]
+    pub fn prefix_matches<'a, 'b>(
+        &'a self,
+        prefix: &str,
+        lattice: &'b mut Lattice<'a>,
+    ) -> PrefixMatches<'b> {
+        PrefixMatches::from_node_option(self.prefix_search(prefix, lattice))
+    }
+
+    /// Performs [`Model::prefix_search()`] for each of `prefixes` in one call, and stores the
+    /// matches of the `k`-th prefix into `tokens` as the `k`-th sentence, whose surface ranges are
+    /// relative to `prefixes[k]`.
+    ///
+    /// `lattice` is used only for allocating nodes, and is cleared. `tokens` is cleared first and
+    /// keeps its allocations, so neither of them needs to be created per lookup.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Model, TokenBuffer};
+    /// # fn test(model: &Model) {
+    /// let mut lattice = model.create_lattice();
+    /// let mut tokens = TokenBuffer::new();
+    ///
+    /// let prefixes = ["東京都", "京都府"];
+    /// assert!(model.lookup_batch(&mut lattice, &prefixes, &mut tokens));
+    /// for (prefix, matches) in prefixes.iter().zip(tokens.sentences()) {
+    ///     for token in matches {
+    ///         println!("{prefix}: {}", &prefix[token.surface_range()]);
+    ///     }
+    /// }
+    /// # }
+    /// ```
+    pub fn lookup_batch(
+        &self,
+        lattice: &mut Lattice<'_>,
+        prefixes: &[&str],
+        tokens: &mut TokenBuffer,
+    ) -> bool {
+        let ptrs: Vec<*const c_char> = prefixes.iter().map(|s| s.as_ptr() as _).collect();
+        let lens: Vec<size_t> = prefixes.iter().map(|s| s.len()).collect();
+
+        tokens.clear();
+        let mut sink = tokens.sink(prefixes.len());
+        unsafe {
+            let n = lookup_batch(
+                self.void_model.as_ptr(),
+                lattice.as_mut_ptr(),
+                ptrs.as_ptr(),
+                lens.as_ptr(),
+                prefixes.len(),
+                &mut sink,
+            );
+            tokens.commit(&sink);
+            n == prefixes.len()
+        }
+    }
+
+    /// Performs [`Model::prefix_search()`] for every suffix of `text` in one call. The `k`-th
+    /// sentence of `tokens` has the matches beginning at the `k`-th character of `text`, and the
+    /// surface ranges are relative to `text`.
+    ///
+    /// See [`Model::lookup_batch()`] for `lattice` and `tokens`.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Model, TokenBuffer};
+    /// # fn test(model: &Model) {
+    /// let mut lattice = model.create_lattice();
+    /// let mut tokens = TokenBuffer::new();
+    ///
+    /// let text = "東京都";
+    /// model.lookup_suffixes(&mut lattice, text, &mut tokens);
+    /// for ((pos, _), matches) in text.char_indices().zip(tokens.sentences()) {
+    ///     for token in matches {
+    ///         println!("{pos}: {}", &text[token.surface_range()]);
+    ///     }
+    /// }
+    /// # }
+    /// ```
+    pub fn lookup_suffixes(
+        &self,
+        lattice: &mut Lattice<'_>,
+        text: &str,
+        tokens: &mut TokenBuffer,
+    ) -> bool {
+        tokens.clear();
+        let mut sink = tokens.sink(text.chars().count());
+        unsafe {
+            let ok = lookup_suffixes(
+                self.void_model.as_ptr(),
+                lattice.as_mut_ptr(),
+                text.as_ptr() as _,
+                text.len(),
+                &mut sink,
+            );
+            tokens.commit(&sink);
+            ok
+        }
+    }
 }
 
 impl Drop for Model {
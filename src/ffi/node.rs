@@ -1,4 +1,4 @@
-use crate::FeatureReader;
+use crate::{FeatureFields, FeatureReader};
 
 use libc::{c_char, c_float, c_int, c_long, c_short, c_uchar, c_uint, c_ushort};
 
@@ -11,6 +11,14 @@ use std::str::Utf8Error;
 #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
 pub struct Attribute(pub(crate) c_ushort);
 
+impl Attribute {
+    /// Raw attribute ID, as in `matrix.def`.
+    #[inline]
+    pub fn id(self) -> c_ushort {
+        self.0
+    }
+}
+
 /// Status of a node. This is a return value of [`Node::status()`].
 #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
 pub enum NodeStatus {
@@ -27,6 +35,17 @@ pub enum NodeStatus {
 }
 
 impl NodeStatus {
+    #[inline]
+    pub(crate) fn from_stat(stat: c_uchar) -> Self {
+        match stat {
+            0 => Self::Normal,
+            1 => Self::Unknown,
+            2 => Self::Bos,
+            3 => Self::Eos,
+            _ => Self::EoNbest,
+        }
+    }
+
     #[inline]
     pub fn is_normal(self) -> bool {
         self == Self::Normal
@@ -183,13 +202,7 @@ impl Node {
 
     /// Status of this node.
     pub fn status(&self) -> NodeStatus {
-        match self.stat {
-            0 => NodeStatus::Normal,
-            1 => NodeStatus::Unknown,
-            2 => NodeStatus::Bos,
-            3 => NodeStatus::Eos,
-            _ => NodeStatus::EoNbest,
-        }
+        NodeStatus::from_stat(self.stat)
     }
 
     /// Returns true if this node is best node. Equivalent to `MeCab::Node::isbest == 1`.
@@ -242,6 +255,19 @@ impl Node {
     pub fn feature_reader(&self) -> FeatureReader<'_> {
         FeatureReader::from_node(self)
     }
+    /// Returns an allocation-free iterator of the fields of [`Node::features()`].
+    ///
+    /// This is the same as [`FeatureFields::from_node()`].
+    #[inline]
+    pub fn feature_fields(&self) -> FeatureFields<'_> {
+        FeatureFields::from_node(self)
+    }
+    /// Returns the `i`-th field of [`Node::features()`] without allocation. It returns `None` if
+    /// the index is out-of-bound.
+    #[inline]
+    pub fn feature_at(&self, i: usize) -> Option<&[u8]> {
+        self.feature_fields().nth(i)
+    }
 }
 
 impl Path {
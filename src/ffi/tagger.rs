@@ -1,7 +1,9 @@
-use super::Lattice;
+use super::token_buffer::TokenSink;
+use super::{Lattice, TokenBuffer};
+use crate::Metric;
 
-use libc::c_char;
 use libc::c_void;
+use libc::{c_char, size_t};
 type VoidPtr = *mut c_void;
 
 use std::ffi::CStr;
@@ -14,6 +16,14 @@ extern "C" {
     fn delete_tagger(tagger: VoidPtr);
 
     fn parse(tagger: VoidPtr, lattice: VoidPtr) -> bool;
+    fn parse_batch(
+        tagger: VoidPtr,
+        lattice: VoidPtr,
+        inputs: *const *const c_char,
+        lens: *const size_t,
+        n: size_t,
+        sink: *mut TokenSink,
+    ) -> size_t;
 
     fn tagger_what(tagger: VoidPtr) -> *const c_char;
     fn tagger_version() -> *const c_char;
@@ -33,8 +43,69 @@ impl<'a> Tagger<'a> {
         })
     }
 
+    #[cfg(feature = "baseline")]
+    #[inline]
+    pub(crate) fn as_ptr(&self) -> VoidPtr {
+        self.void_tagger.as_ptr()
+    }
+
     pub fn parse(&self, lattice: &mut Lattice) -> bool {
-        unsafe { parse(self.void_tagger.as_ptr(), lattice.as_mut_ptr()) }
+        let ok = crate::metrics::timed(Metric::Parse, || unsafe {
+            parse(self.void_tagger.as_ptr(), lattice.as_mut_ptr())
+        });
+        if ok {
+            lattice.record_stats();
+        }
+        ok
+    }
+
+    /// Parses all the `inputs` in `lattice` and stores their tokens into `tokens`, crossing the
+    /// FFI boundary only once.
+    ///
+    /// `tokens` is cleared first, and then the `k`-th sentence of `tokens` holds the best path of
+    /// `inputs[k]`. Surface ranges of the tokens are relative to each input.
+    ///
+    /// Returns false if some input cannot be parsed. In that case, `tokens` holds only the
+    /// sentences before the failed one (see [`TokenBuffer::sentence_count()`]), and the cause is
+    /// available via [`Lattice::error()`].
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Model, TokenBuffer};
+    /// # fn test(model: &Model) {
+    /// let tagger = model.create_tagger().unwrap();
+    /// let mut lattice = model.create_lattice();
+    /// let mut tokens = TokenBuffer::new();
+    ///
+    /// let inputs = ["Foo.", "Bar."];
+    /// assert!(tagger.parse_batch(&mut lattice, &inputs, &mut tokens));
+    /// assert_eq!(tokens.sentence_count(), 2);
+    /// # }
+    /// ```
+    pub fn parse_batch(
+        &self,
+        lattice: &mut Lattice,
+        inputs: &[&str],
+        tokens: &mut TokenBuffer,
+    ) -> bool {
+        let ptrs: Vec<*const c_char> = inputs.iter().map(|s| s.as_ptr() as _).collect();
+        let lens: Vec<size_t> = inputs.iter().map(|s| s.len()).collect();
+
+        tokens.clear();
+        let mut sink = tokens.sink(inputs.len());
+        unsafe {
+            let n = crate::metrics::timed(Metric::ParseBatch, || {
+                parse_batch(
+                    self.void_tagger.as_ptr(),
+                    lattice.as_mut_ptr(),
+                    ptrs.as_ptr(),
+                    lens.as_ptr(),
+                    inputs.len(),
+                    &mut sink,
+                )
+            });
+            tokens.commit(&sink);
+            n == inputs.len()
+        }
     }
 
     pub fn error(&self) -> &[u8] {
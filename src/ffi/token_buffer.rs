@@ -0,0 +1,589 @@
+use super::{Attribute, NodeStatus};
+use crate::FeatureFields;
+
+use libc::{c_char, c_long, c_short, c_uchar, c_ushort, size_t};
+
+use libc::c_void;
+
+use std::ops::Range;
+use std::str::Utf8Error;
+
+/// Column pointers handed to the C++ shims. It has the same layout as `token_sink_t` in
+/// `lib/cmecab.cpp`.
+#[repr(C)]
+pub(crate) struct TokenSink {
+    ctx: *mut c_void,
+    reserve: extern "C" fn(sink: *mut TokenSink, tokens: size_t, bytes: size_t) -> bool,
+
+    len: size_t,
+    cap: size_t,
+    begin: *mut size_t,
+    length: *mut c_ushort,
+    posid: *mut c_ushort,
+    rattr: *mut c_ushort,
+    lattr: *mut c_ushort,
+    wcost: *mut c_short,
+    cost: *mut c_long,
+    stat: *mut c_uchar,
+    feature_end: *mut size_t,
+
+    features: *mut c_char,
+    features_len: size_t,
+    features_cap: size_t,
+
+    sentence_end: *mut size_t,
+    sentences_len: size_t,
+}
+
+extern "C" fn reserve_sink(sink: *mut TokenSink, tokens: size_t, bytes: size_t) -> bool {
+    unsafe {
+        let sink = &mut *sink;
+        let buf = &mut *(sink.ctx as *mut TokenBuffer);
+        buf.commit(sink);
+        buf.reserve(tokens, bytes);
+        buf.refresh(sink);
+    }
+    true
+}
+
+/// Tokens of one or more parsed sentences, stored as a struct of arrays.
+///
+/// Each column (surface offsets, `posid`, attributes, costs, ...) is a contiguous array with one
+/// element per token. BOS/EOS nodes are not stored. The features of all the tokens
+/// are copied into one packed arena, so a `TokenBuffer` does not borrow the lattice that produced
+/// it.
+///
+/// A `TokenBuffer` is filled by [`Lattice::export_tokens()`](crate::Lattice::export_tokens()) or
+/// [`Tagger::parse_batch()`](crate::Tagger::parse_batch()). Methods
+/// filling a buffer clear it first but keep its allocations, so reusing one buffer across calls
+/// does not allocate once it has grown large enough.
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, Tagger, TokenBuffer};
+/// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>) {
+/// let inputs = ["Foo.", "Bar."];
+/// let mut tokens = TokenBuffer::new();
+///
+/// if tagger.parse_batch(lattice, &inputs, &mut tokens) {
+///     for (input, sentence) in inputs.iter().zip(tokens.sentences()) {
+///         for token in sentence {
+///             println!("{} {}", &input[token.surface_range()], token.features_str().unwrap());
+///         }
+///     }
+/// }
+/// # }
+/// ```
+#[derive(Debug, Default, Clone)]
+pub struct TokenBuffer {
+    begins: Vec<usize>,
+    lengths: Vec<c_ushort>,
+    posids: Vec<c_ushort>,
+    rattrs: Vec<Attribute>,
+    lattrs: Vec<Attribute>,
+    wcosts: Vec<c_short>,
+    costs: Vec<c_long>,
+    stats: Vec<c_uchar>,
+    feature_ends: Vec<usize>,
+    features: Vec<u8>,
+    sentence_ends: Vec<usize>,
+}
+
+impl TokenBuffer {
+    #[inline]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Removes all the tokens and sentences, keeping the allocated memory.
+    pub fn clear(&mut self) {
+        self.begins.clear();
+        self.lengths.clear();
+        self.posids.clear();
+        self.rattrs.clear();
+        self.lattrs.clear();
+        self.wcosts.clear();
+        self.costs.clear();
+        self.stats.clear();
+        self.feature_ends.clear();
+        self.features.clear();
+        self.sentence_ends.clear();
+    }
+
+    /// The number of tokens in all the sentences.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.begins.len()
+    }
+
+    /// Returns true if `self` has no tokens.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.begins.is_empty()
+    }
+
+    /// The number of sentences.
+    #[inline]
+    pub fn sentence_count(&self) -> usize {
+        self.sentence_ends.len()
+    }
+
+    /// Range of the token indices of the `k`-th sentence. It returns `None` if the index is
+    /// out-of-bound.
+    pub fn sentence_range(&self, k: usize) -> Option<Range<usize>> {
+        let end = *self.sentence_ends.get(k)?;
+        let begin = if k == 0 { 0 } else { self.sentence_ends[k - 1] };
+        Some(begin..end)
+    }
+
+    /// Tokens of the `k`-th sentence. It returns `None` if the index is out-of-bound.
+    pub fn sentence(&self, k: usize) -> Option<Tokens<'_>> {
+        let range = self.sentence_range(k)?;
+        Some(Tokens { buf: self, range })
+    }
+
+    /// Returns an iterator of the tokens of each sentence.
+    pub fn sentences(&self) -> impl Iterator<Item = Tokens<'_>> + ExactSizeIterator {
+        (0..self.sentence_count()).map(|k| {
+            let range = self.sentence_range(k).unwrap();
+            Tokens { buf: self, range }
+        })
+    }
+
+    /// Returns an iterator of all the tokens.
+    pub fn tokens(&self) -> Tokens<'_> {
+        Tokens {
+            buf: self,
+            range: 0..self.len(),
+        }
+    }
+
+    /// Gets the `i`-th token. It returns `None` if the index is out-of-bound.
+    pub fn get(&self, i: usize) -> Option<Token<'_>> {
+        if i < self.len() {
+            Some(Token {
+                buf: self,
+                index: i,
+            })
+        } else {
+            None
+        }
+    }
+
+    /// Begin offsets of the surface strings in the parsed sentences.
+    #[inline]
+    pub fn begins(&self) -> &[usize] {
+        &self.begins
+    }
+
+    /// Lengths of the surface strings. See [`Node::length`](crate::Node::length).
+    #[inline]
+    pub fn lengths(&self) -> &[c_ushort] {
+        &self.lengths
+    }
+
+    /// See [`Node::posid`](crate::Node::posid).
+    #[inline]
+    pub fn posids(&self) -> &[c_ushort] {
+        &self.posids
+    }
+
+    /// See [`Node::rattr`](crate::Node::rattr).
+    #[inline]
+    pub fn rattrs(&self) -> &[Attribute] {
+        &self.rattrs
+    }
+
+    /// See [`Node::lattr`](crate::Node::lattr).
+    #[inline]
+    pub fn lattrs(&self) -> &[Attribute] {
+        &self.lattrs
+    }
+
+    /// See [`Node::wcost`](crate::Node::wcost).
+    #[inline]
+    pub fn wcosts(&self) -> &[c_short] {
+        &self.wcosts
+    }
+
+    /// See [`Node::cost`](crate::Node::cost).
+    #[inline]
+    pub fn costs(&self) -> &[c_long] {
+        &self.costs
+    }
+
+    /// Raw values of `MeCab::Node::stat`. Use [`Token::status()`] to get [`NodeStatus`].
+    #[inline]
+    pub fn stats(&self) -> &[c_uchar] {
+        &self.stats
+    }
+
+    /// The packed arena of the features of all the tokens. The features of the `i`-th token are
+    /// `feature_arena()[feature_ends()[i - 1]..feature_ends()[i]]` (the begin is `0` if `i == 0`).
+    #[inline]
+    pub fn feature_arena(&self) -> &[u8] {
+        &self.features
+    }
+
+    /// End offsets of the features in [`TokenBuffer::feature_arena()`].
+    #[inline]
+    pub fn feature_ends(&self) -> &[usize] {
+        &self.feature_ends
+    }
+
+    /// End indices of the tokens of each sentence. See also [`TokenBuffer::sentence_range()`].
+    #[inline]
+    pub fn sentence_ends(&self) -> &[usize] {
+        &self.sentence_ends
+    }
+
+    /// Bytes allocated for the columns, counting their capacity.
+    pub fn heap_size(&self) -> usize {
+        use std::mem::size_of;
+        let tokens = size_of::<usize>() * (self.begins.capacity() + self.feature_ends.capacity())
+            + size_of::<c_ushort>() * (self.lengths.capacity() + self.posids.capacity())
+            + size_of::<Attribute>() * (self.rattrs.capacity() + self.lattrs.capacity())
+            + size_of::<c_short>() * self.wcosts.capacity()
+            + size_of::<c_long>() * self.costs.capacity()
+            + size_of::<c_uchar>() * self.stats.capacity();
+        tokens + self.features.capacity() + size_of::<usize>() * self.sentence_ends.capacity()
+    }
+
+    /// Shrinks the capacity of every column to its length.
+    pub fn shrink_to_fit(&mut self) {
+        self.begins.shrink_to_fit();
+        self.lengths.shrink_to_fit();
+        self.posids.shrink_to_fit();
+        self.rattrs.shrink_to_fit();
+        self.lattrs.shrink_to_fit();
+        self.wcosts.shrink_to_fit();
+        self.costs.shrink_to_fit();
+        self.stats.shrink_to_fit();
+        self.feature_ends.shrink_to_fit();
+        self.features.shrink_to_fit();
+        self.sentence_ends.shrink_to_fit();
+    }
+
+    /// Appends a token to the current sentence.
+    #[allow(clippy::too_many_arguments)]
+    pub(crate) fn push_token(
+        &mut self,
+        begin: usize,
+        length: c_ushort,
+        posid: c_ushort,
+        rattr: Attribute,
+        lattr: Attribute,
+        wcost: c_short,
+        cost: c_long,
+        stat: c_uchar,
+        features: &[u8],
+    ) {
+        self.begins.push(begin);
+        self.lengths.push(length);
+        self.posids.push(posid);
+        self.rattrs.push(rattr);
+        self.lattrs.push(lattr);
+        self.wcosts.push(wcost);
+        self.costs.push(cost);
+        self.stats.push(stat);
+        self.features.extend_from_slice(features);
+        self.feature_ends.push(self.features.len());
+    }
+
+    /// Ends the current sentence at the last token pushed.
+    pub(crate) fn close_sentence(&mut self) {
+        self.sentence_ends.push(self.len());
+    }
+
+    /// Replaces the tokens in `range` with all the tokens of `other`, adding `offset` to their
+    /// begins, and adds `shift` to the begins of the tokens after them. `self` is left with one
+    /// sentence of all its tokens.
+    pub(crate) fn splice(
+        &mut self,
+        range: Range<usize>,
+        other: &TokenBuffer,
+        offset: usize,
+        shift: isize,
+    ) {
+        let feature_end = |i: usize| if i == 0 { 0 } else { self.feature_ends[i - 1] };
+        let features = feature_end(range.start)..feature_end(range.end);
+        let feature_shift = other.features.len() as isize - features.len() as isize;
+        let tail = range.start + other.len();
+
+        let r = range.clone();
+        self.begins
+            .splice(r, other.begins.iter().map(|&b| b + offset));
+        for b in &mut self.begins[tail..] {
+            *b = (*b as isize + shift) as usize;
+        }
+        let base = features.start;
+        self.feature_ends
+            .splice(range.clone(), other.feature_ends.iter().map(|&e| e + base));
+        for e in &mut self.feature_ends[tail..] {
+            *e = (*e as isize + feature_shift) as usize;
+        }
+        self.features
+            .splice(features, other.features.iter().copied());
+
+        self.lengths
+            .splice(range.clone(), other.lengths.iter().copied());
+        self.posids
+            .splice(range.clone(), other.posids.iter().copied());
+        self.rattrs
+            .splice(range.clone(), other.rattrs.iter().copied());
+        self.lattrs
+            .splice(range.clone(), other.lattrs.iter().copied());
+        self.wcosts
+            .splice(range.clone(), other.wcosts.iter().copied());
+        self.costs
+            .splice(range.clone(), other.costs.iter().copied());
+        self.stats.splice(range, other.stats.iter().copied());
+
+        self.sentence_ends.clear();
+        self.sentence_ends.push(self.len());
+    }
+
+    fn reserve(&mut self, tokens: usize, bytes: usize) {
+        self.begins.reserve(tokens);
+        self.lengths.reserve(tokens);
+        self.posids.reserve(tokens);
+        self.rattrs.reserve(tokens);
+        self.lattrs.reserve(tokens);
+        self.wcosts.reserve(tokens);
+        self.costs.reserve(tokens);
+        self.stats.reserve(tokens);
+        self.feature_ends.reserve(tokens);
+        self.features.reserve(bytes);
+    }
+
+    fn capacity(&self) -> usize {
+        [
+            self.begins.capacity(),
+            self.lengths.capacity(),
+            self.posids.capacity(),
+            self.rattrs.capacity(),
+            self.lattrs.capacity(),
+            self.wcosts.capacity(),
+            self.costs.capacity(),
+            self.stats.capacity(),
+            self.feature_ends.capacity(),
+        ]
+        .into_iter()
+        .min()
+        .unwrap()
+    }
+
+    fn refresh(&mut self, sink: &mut TokenSink) {
+        sink.len = self.len();
+        sink.cap = self.capacity();
+        sink.begin = self.begins.as_mut_ptr();
+        sink.length = self.lengths.as_mut_ptr();
+        sink.posid = self.posids.as_mut_ptr();
+        sink.rattr = self.rattrs.as_mut_ptr() as _;
+        sink.lattr = self.lattrs.as_mut_ptr() as _;
+        sink.wcost = self.wcosts.as_mut_ptr();
+        sink.cost = self.costs.as_mut_ptr();
+        sink.stat = self.stats.as_mut_ptr();
+        sink.feature_end = self.feature_ends.as_mut_ptr();
+        sink.features = self.features.as_mut_ptr() as _;
+        sink.features_len = self.features.len();
+        sink.features_cap = self.features.capacity();
+        sink.sentence_end = self.sentence_ends.as_mut_ptr();
+        sink.sentences_len = self.sentence_ends.len();
+    }
+
+    /// Returns column pointers with room for `sentences` more sentences.
+    ///
+    /// The returned sink must be passed to [`TokenBuffer::commit()`] after the C++ side has
+    /// filled it, and `self` must not be touched in between.
+    pub(crate) fn sink(&mut self, sentences: usize) -> TokenSink {
+        self.sentence_ends.reserve(sentences);
+        let mut sink = TokenSink {
+            ctx: self as *mut Self as _,
+            reserve: reserve_sink,
+            len: 0,
+            cap: 0,
+            begin: std::ptr::null_mut(),
+            length: std::ptr::null_mut(),
+            posid: std::ptr::null_mut(),
+            rattr: std::ptr::null_mut(),
+            lattr: std::ptr::null_mut(),
+            wcost: std::ptr::null_mut(),
+            cost: std::ptr::null_mut(),
+            stat: std::ptr::null_mut(),
+            feature_end: std::ptr::null_mut(),
+            features: std::ptr::null_mut(),
+            features_len: 0,
+            features_cap: 0,
+            sentence_end: std::ptr::null_mut(),
+            sentences_len: 0,
+        };
+        self.refresh(&mut sink);
+        sink
+    }
+
+    /// Takes in the elements written through `sink`.
+    ///
+    /// # Safety
+    /// `sink` must be returned by [`TokenBuffer::sink()`] of `self`, and the C++ side must have
+    /// initialized every element below the lengths it reports.
+    pub(crate) unsafe fn commit(&mut self, sink: &TokenSink) {
+        let len = sink.len;
+        self.begins.set_len(len);
+        self.lengths.set_len(len);
+        self.posids.set_len(len);
+        self.rattrs.set_len(len);
+        self.lattrs.set_len(len);
+        self.wcosts.set_len(len);
+        self.costs.set_len(len);
+        self.stats.set_len(len);
+        self.feature_ends.set_len(len);
+        self.features.set_len(sink.features_len);
+        self.sentence_ends.set_len(sink.sentences_len);
+    }
+}
+
+/// Iterator of [`Token`]s in a [`TokenBuffer`].
+#[derive(Debug, Clone)]
+pub struct Tokens<'a> {
+    buf: &'a TokenBuffer,
+    range: Range<usize>,
+}
+
+impl<'a> Tokens<'a> {
+    /// Range of the token indices this iterator has not yielded yet.
+    #[inline]
+    pub fn range(&self) -> Range<usize> {
+        self.range.clone()
+    }
+}
+
+impl<'a> Iterator for Tokens<'a> {
+    type Item = Token<'a>;
+
+    #[inline]
+    fn next(&mut self) -> Option<Self::Item> {
+        let index = self.range.next()?;
+        Some(Token {
+            buf: self.buf,
+            index,
+        })
+    }
+
+    #[inline]
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        self.range.size_hint()
+    }
+}
+
+impl<'a> DoubleEndedIterator for Tokens<'a> {
+    #[inline]
+    fn next_back(&mut self) -> Option<Self::Item> {
+        let index = self.range.next_back()?;
+        Some(Token {
+            buf: self.buf,
+            index,
+        })
+    }
+}
+
+impl<'a> ExactSizeIterator for Tokens<'a> {}
+
+/// A token in a [`TokenBuffer`]. It corresponds to a [`Node`](crate::Node) on the best path.
+#[derive(Debug, Clone, Copy)]
+pub struct Token<'a> {
+    buf: &'a TokenBuffer,
+    index: usize,
+}
+
+impl<'a> Token<'a> {
+    /// Index of `self` in the [`TokenBuffer`].
+    #[inline]
+    pub fn index(self) -> usize {
+        self.index
+    }
+
+    /// Byte range of the surface string in the parsed sentence.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::Token;
+    /// # fn test(sentence: &str, token: Token<'_>) {
+    /// let surface = &sentence[token.surface_range()];
+    /// # }
+    /// ```
+    #[inline]
+    pub fn surface_range(self) -> Range<usize> {
+        let begin = self.buf.begins[self.index];
+        begin..begin + self.surface_len()
+    }
+
+    /// Length of the surface string. Equivalent to [`Node::length`](crate::Node::length).
+    #[inline]
+    pub fn surface_len(self) -> usize {
+        self.buf.lengths[self.index] as _
+    }
+
+    /// Equivalent to [`Node::posid`](crate::Node::posid).
+    #[inline]
+    pub fn posid(self) -> c_ushort {
+        self.buf.posids[self.index]
+    }
+
+    /// Equivalent to [`Node::rattr`](crate::Node::rattr).
+    #[inline]
+    pub fn rattr(self) -> Attribute {
+        self.buf.rattrs[self.index]
+    }
+
+    /// Equivalent to [`Node::lattr`](crate::Node::lattr).
+    #[inline]
+    pub fn lattr(self) -> Attribute {
+        self.buf.lattrs[self.index]
+    }
+
+    /// Equivalent to [`Node::wcost`](crate::Node::wcost).
+    #[inline]
+    pub fn wcost(self) -> c_short {
+        self.buf.wcosts[self.index]
+    }
+
+    /// Equivalent to [`Node::cost`](crate::Node::cost).
+    #[inline]
+    pub fn cost(self) -> c_long {
+        self.buf.costs[self.index]
+    }
+
+    /// Equivalent to [`Node::status()`](crate::Node::status()).
+    #[inline]
+    pub fn status(self) -> NodeStatus {
+        NodeStatus::from_stat(self.buf.stats[self.index])
+    }
+
+    /// Feature string. Equivalent to [`Node::features()`](crate::Node::features()).
+    pub fn features(self) -> &'a [u8] {
+        let i = self.index;
+        let begin = if i == 0 {
+            0
+        } else {
+            self.buf.feature_ends[i - 1]
+        };
+        &self.buf.features[begin..self.buf.feature_ends[i]]
+    }
+
+    /// Converts [`Token::features()`] as a [`&str`].
+    pub fn features_str(self) -> Result<&'a str, Utf8Error> {
+        std::str::from_utf8(self.features())
+    }
+
+    /// Returns an allocation-free iterator of the fields of [`Token::features()`].
+    #[inline]
+    pub fn feature_fields(self) -> FeatureFields<'a> {
+        FeatureFields::new(self.features())
+    }
+
+    /// Returns the `i`-th field of [`Token::features()`]. It returns `None` if the index is
+    /// out-of-bound.
+    #[inline]
+    pub fn feature_at(self, i: usize) -> Option<&'a [u8]> {
+        self.feature_fields().nth(i)
+    }
+}
@@ -127,6 +127,93 @@
 //! }
 //! ```
 //!
+//! Or share a tagger and reuse lattices through a [`LatticePool`], so that no lattice is created
+//! per task:
+//!
+//! ```no_run
+//! use mecab_wrapper::{LatticePool, Model, Tagger, global_error_str};
+//!
+//! use futures::stream::{FuturesUnordered, StreamExt};
+//!
+//! #[tokio::main]
+//! async fn main() {
+//!     let inputs = ["Foo.", "Bar."];
+//!
+//!     let model = if let Some(model) = Model::new("-d /path/to/model/dir") {
+//!         model
+//!     } else {
+//!         println!("null model: {}", global_error_str().unwrap());
+//!         return;
+//!     };
+//!     let tagger = if let Some(tagger) = model.create_tagger() {
+//!         tagger
+//!     } else {
+//!         println!("null tagger: {}", global_error_str().unwrap());
+//!         return;
+//!     };
+//!     let pool = model.pool(2);
+//!
+//!     let mut tasks = FuturesUnordered::new();
+//!
+//!     for i in 0..2 {
+//!         let task = test_model(&pool, &tagger, inputs[i]);
+//!         tasks.push(task);
+//!     }
+//!
+//!     while tasks.next().await.is_some() {}
+//! }
+//!
+//! async fn test_model(pool: &LatticePool<'_>, tagger: &Tagger<'_>, input: &str) {
+//!     let mut lattice = pool.get();
+//!     lattice.set_sentence(input);
+//!     if !tagger.parse(&mut lattice) {
+//!         println!(
+//!             "could not parse into the lattice: {}",
+//!             global_error_str().unwrap()
+//!         );
+//!         return;
+//!     }
+//!
+//!     for node in lattice.iter_nodes() {
+//!         println!(
+//!             "{:?} {} {}",
+//!             node.status(),
+//!             node.surface_str().unwrap(),
+//!             node.features_str().unwrap()
+//!         );
+//!     }
+//! }
+//! ```
+//!
+//! The examples above parse on the executor threads, which blocks the other tasks while long
+//! inputs are parsed. [`AsyncTagger`] parses on its own worker threads instead, batching the
+//! queued requests:
+//!
+//! ```no_run
+//! use mecab_wrapper::{AsyncOptions, AsyncTagger, Model};
+//!
+//! use futures::stream::{FuturesUnordered, StreamExt};
+//! use std::sync::Arc;
+//!
+//! #[tokio::main]
+//! async fn main() {
+//!     let model = Arc::new(Model::new("-d /path/to/model/dir").unwrap());
+//!     let tagger = AsyncTagger::new(model, AsyncOptions::new(2)).unwrap();
+//!
+//!     let mut tasks: FuturesUnordered<_> = ["Foo.", "Bar."]
+//!         .into_iter()
+//!         .map(|input| tagger.parse(input))
+//!         .collect();
+//!
+//!     while let Some(parsed) = tasks.next().await {
+//!         let parsed = parsed.unwrap();
+//!         for token in parsed.tokens() {
+//!             println!("{} {}", &parsed.text()[token.surface_range()], token.features_str().unwrap());
+//!         }
+//!     }
+//! }
+//! ```
+//!
 //! # Useful iterators
 //!
 //! `mecab-wrapper` defines two useful iterators: [`NodeIter`], [`NodeRevIter`] and [`Features`]
@@ -214,6 +301,24 @@
 //! # Ok(())
 //! # }
 //! ```
+//!
+//! [`FeatureReader`] allocates a [`csv::ByteRecord`] for each node. On hot paths, prefer
+//! [`FeatureFields`] ([`Node::feature_fields()`]) and [`Node::feature_at()`], which split the
+//! features without allocation:
+//!
+//! ```no_run
+//! # use mecab_wrapper::Node;
+//! # fn test_feat_fields(node: &Node) {
+//! for field in node.feature_fields() {
+//!     println!("{:?}", field);
+//! }
+//!
+//! let pos = node.feature_at(0);
+//! # }
+//! ```
+//!
+//! If the same dictionary entries appear again and again, [`FeatureCache`] keeps the split fields
+//! of each entry ([`Node::cached_features()`]).
 
 #[cfg(feature = "cmecab")]
 mod ffi;
@@ -223,10 +328,115 @@ pub use ffi::*;
 #[cfg(feature = "cmecab")]
 mod node_iter;
 #[cfg(feature = "cmecab")]
-pub use node_iter::{NodeIter, NodeRevIter};
+pub use node_iter::{
+    BestTokens, FilterPosid, NbestIter, NodeBnextIter, NodeEnextIter, NodeIter, NodeRevIter,
+    PosidSet, PrefixMatches, Surfaces,
+};
+
+#[cfg(feature = "cmecab")]
+mod pool;
+#[cfg(feature = "cmecab")]
+pub use pool::{LatticePool, PooledLattice};
+
+#[cfg(feature = "cmecab")]
+mod parallel;
+#[cfg(feature = "cmecab")]
+pub use parallel::{OutputOrder, ParallelOptions};
+
+#[cfg(feature = "cmecab")]
+mod mmap;
+#[cfg(feature = "cmecab")]
+pub use mmap::MmapFile;
+
+#[cfg(feature = "cmecab")]
+mod token_stream;
+#[cfg(feature = "cmecab")]
+pub use token_stream::TokenStream;
+
+#[cfg(feature = "cmecab")]
+mod format;
+#[cfg(feature = "cmecab")]
+pub use format::{FormatError, FormatErrorKind, Formatter};
+
+#[cfg(feature = "cmecab")]
+mod shared_model;
+#[cfg(feature = "cmecab")]
+pub use shared_model::{ModelSnapshot, SharedModel};
+
+#[cfg(feature = "cmecab")]
+mod warmup;
+#[cfg(feature = "cmecab")]
+pub use warmup::{DictionaryFile, Prefetch, PrefetchError, WarmupOptions, WarmupReport};
+
+#[cfg(feature = "cmecab")]
+mod viterbi;
+#[cfg(feature = "cmecab")]
+pub use viterbi::{CostHook, NoAdjustment, Viterbi};
+
+#[cfg(feature = "cmecab")]
+mod async_tagger;
+#[cfg(feature = "cmecab")]
+pub use async_tagger::{AsyncError, AsyncOptions, AsyncTagger, ParseFuture, Parsed};
+
+#[cfg(feature = "cmecab")]
+mod sentence_cache;
+#[cfg(feature = "cmecab")]
+pub use sentence_cache::{CacheOptions, CacheStats, SentenceCache};
+
+#[cfg(feature = "cmecab")]
+mod packed;
+#[cfg(feature = "cmecab")]
+pub use packed::{DecodeError, PackedIter, PackedToken, PackedTokens};
+
+#[cfg(feature = "cmecab")]
+mod document;
+#[cfg(feature = "cmecab")]
+pub use document::{Chunk, DocumentOptions, DocumentParser};
+
+#[cfg(feature = "cmecab")]
+mod pos_interner;
+#[cfg(feature = "cmecab")]
+pub use pos_interner::{PosId, PosInterner, DEFAULT_POS_FIELDS};
+
+#[cfg(feature = "cmecab")]
+mod user_dictionary;
+#[cfg(feature = "cmecab")]
+pub use user_dictionary::{CompileError, EntryError, EntryErrorKind, UserDictionary};
+
+#[cfg(feature = "cmecab")]
+mod sentence_index;
+#[cfg(feature = "cmecab")]
+pub use sentence_index::SentenceIndex;
+
+#[cfg(feature = "cmecab")]
+mod registry;
+#[cfg(feature = "cmecab")]
+pub use registry::{ModelRegistry, ResidentMemory};
+
+#[cfg(feature = "cmecab")]
+mod reparse;
+#[cfg(feature = "cmecab")]
+pub use reparse::{Edit, DEFAULT_CONTEXT_TOKENS};
+
+#[cfg(feature = "baseline")]
+#[doc(hidden)]
+pub mod baseline;
+
+#[cfg(feature = "cmecab")]
+mod feature_cache;
+#[cfg(feature = "cmecab")]
+pub use feature_cache::{CachedFeatures, FeatureCache};
+
+mod metrics;
+pub use metrics::{
+    clear_metrics_sink, lattice_stats_enabled, metrics_enabled, set_lattice_stats,
+    set_metrics_sink, Histogram, HistogramSink, Metric, MetricsSink,
+};
 
 mod feat;
+pub use feat::feature_at;
 pub use feat::Feature;
+pub use feat::FeatureFields;
 pub use feat::FeatureReader;
 pub use feat::Features;
 pub use feat::IntoIter as FeaturesIntoIter;
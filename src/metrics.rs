@@ -0,0 +1,310 @@
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, RwLock};
+use std::time::Instant;
+
+/// Values recorded by the instrumented calls. Durations are in nanoseconds.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
+pub enum Metric {
+    /// [`Lattice::set_sentence()`](crate::Lattice::set_sentence()).
+    SetSentence,
+    /// [`Tagger::parse()`](crate::Tagger::parse()), i.e., dictionary lookup and Viterbi in MeCab.
+    Parse,
+    /// [`Tagger::parse_batch()`](crate::Tagger::parse_batch()), per call.
+    ParseBatch,
+    /// Rendering the lattice to a string: [`Lattice::to_bytes()`](crate::Lattice::to_bytes()),
+    /// [`Lattice::write_to()`](crate::Lattice::write_to()), their N-best variants and
+    /// [`Formatter::render()`](crate::Formatter::render()).
+    Render,
+    /// [`Lattice::export_tokens()`](crate::Lattice::export_tokens()) and
+    /// [`Lattice::export_graph()`](crate::Lattice::export_graph()).
+    Export,
+    /// [`FeatureReader::features()`](crate::FeatureReader::features()).
+    Features,
+    /// The number of candidate nodes in a parsed lattice, including BOS/EOS. This and the
+    /// following metrics are recorded by [`Tagger::parse()`](crate::Tagger::parse()) only if
+    /// enabled by [`set_lattice_stats()`].
+    LatticeNodes,
+    /// The number of unknown-word candidate nodes in a parsed lattice.
+    UnknownNodes,
+    /// The number of nodes on the best path of a parsed lattice, including BOS/EOS.
+    BestPathNodes,
+    /// Estimated bytes MeCab allocated for the nodes and paths of a parsed lattice.
+    LatticeBytes,
+}
+
+impl Metric {
+    /// All the metrics, in the order of their discriminants.
+    pub const ALL: [Metric; 10] = [
+        Metric::SetSentence,
+        Metric::Parse,
+        Metric::ParseBatch,
+        Metric::Render,
+        Metric::Export,
+        Metric::Features,
+        Metric::LatticeNodes,
+        Metric::UnknownNodes,
+        Metric::BestPathNodes,
+        Metric::LatticeBytes,
+    ];
+
+    /// Returns true if the values are durations in nanoseconds.
+    #[inline]
+    pub fn is_duration(self) -> bool {
+        self < Metric::LatticeNodes
+    }
+}
+
+/// Receiver of the values recorded while metrics are enabled by [`set_metrics_sink()`].
+///
+/// `record()` is called on the thread doing the work, so it should be cheap and must not block.
+/// [`HistogramSink`] is a ready-made implementation.
+pub trait MetricsSink: Send + Sync {
+    fn record(&self, metric: Metric, value: u64);
+}
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static LATTICE_STATS: AtomicBool = AtomicBool::new(false);
+static SINK: RwLock<Option<Arc<dyn MetricsSink>>> = RwLock::new(None);
+
+/// Enables metrics, sending every value to `sink`. Replaces the previous sink, if any.
+///
+/// Metrics are process-wide and disabled by default. While disabled, each instrumented call costs
+/// only one relaxed atomic load.
+///
+/// ```no_run
+/// use mecab_wrapper::{set_metrics_sink, HistogramSink, Metric};
+/// use std::sync::Arc;
+///
+/// let histograms = Arc::new(HistogramSink::new());
+/// set_metrics_sink(histograms.clone());
+///
+/// // ... parse ...
+///
+/// let parse = histograms.histogram(Metric::Parse);
+/// println!("p99 parse: {} ns", parse.percentile(0.99));
+/// ```
+pub fn set_metrics_sink(sink: Arc<dyn MetricsSink>) {
+    *SINK.write().unwrap() = Some(sink);
+    ENABLED.store(true, Ordering::Release);
+}
+
+/// Disables metrics and drops the sink.
+pub fn clear_metrics_sink() {
+    ENABLED.store(false, Ordering::Release);
+    *SINK.write().unwrap() = None;
+}
+
+/// Returns true if a sink is set by [`set_metrics_sink()`].
+#[inline]
+pub fn metrics_enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// Enables or disables the lattice metrics, from [`Metric::LatticeNodes`] to
+/// [`Metric::LatticeBytes`]. They are disabled by default.
+///
+/// While enabled and a sink is set, [`Tagger::parse()`](crate::Tagger::parse()) walks the parsed
+/// lattice once more to count its nodes (see [`Lattice::stats()`](crate::Lattice::stats())), so it
+/// should be left disabled when measuring parse latency.
+/// [`Tagger::parse_batch()`](crate::Tagger::parse_batch()) never records them.
+pub fn set_lattice_stats(enabled: bool) {
+    LATTICE_STATS.store(enabled, Ordering::Relaxed);
+}
+
+/// Returns true if the lattice metrics are recorded, i.e., a sink is set and they are enabled by
+/// [`set_lattice_stats()`].
+#[inline]
+pub fn lattice_stats_enabled() -> bool {
+    metrics_enabled() && LATTICE_STATS.load(Ordering::Relaxed)
+}
+
+/// Sends `value` to the sink, if any.
+pub(crate) fn record(metric: Metric, value: u64) {
+    if let Some(sink) = SINK.read().unwrap().as_ref() {
+        sink.record(metric, value);
+    }
+}
+
+/// Runs `f`, recording its duration as `metric` if metrics are enabled.
+#[inline]
+pub(crate) fn timed<T>(metric: Metric, f: impl FnOnce() -> T) -> T {
+    if !metrics_enabled() {
+        return f();
+    }
+    let start = Instant::now();
+    let ret = f();
+    record(metric, start.elapsed().as_nanos() as u64);
+    ret
+}
+
+/// Bits of the linear sub-buckets of each power of two in a [`Histogram`].
+const SUB_BITS: u32 = 4;
+const SUB_BUCKETS: usize = 1 << SUB_BITS;
+/// The number of buckets of a [`Histogram`]: one for each value below [`SUB_BUCKETS`], then
+/// [`SUB_BUCKETS`] for each power of two up to `2^64`.
+const BUCKETS: usize = SUB_BUCKETS + (64 - SUB_BITS as usize) * SUB_BUCKETS;
+
+#[inline]
+fn bucket(value: u64) -> usize {
+    if value < SUB_BUCKETS as u64 {
+        return value as usize;
+    }
+    // The position of the highest bit, at least `SUB_BITS`, and the bits below it.
+    let msb = u64::BITS - 1 - value.leading_zeros();
+    let shift = msb - SUB_BITS;
+    let sub = (value >> shift) as usize & (SUB_BUCKETS - 1);
+    SUB_BUCKETS + shift as usize * SUB_BUCKETS + sub
+}
+
+/// The largest value counted in the `k`-th bucket.
+#[inline]
+fn bucket_upper(k: usize) -> u64 {
+    if k < SUB_BUCKETS {
+        return k as u64;
+    }
+    let shift = (k - SUB_BUCKETS) / SUB_BUCKETS;
+    let sub = (k % SUB_BUCKETS) as u128;
+    let lower = (SUB_BUCKETS as u128 + sub) << shift;
+    (lower + (1u128 << shift) - 1).min(u64::MAX as u128) as u64
+}
+
+/// Histogram with log-linear buckets: the values below 16 are counted exactly, and each power of
+/// two above is split into 16 buckets of equal width, so a percentile is off by less than 1/16
+/// of its value.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Histogram {
+    pub count: u64,
+    pub sum: u64,
+    pub max: u64,
+    pub buckets: [u64; BUCKETS],
+}
+
+impl Histogram {
+    /// Mean of the values, or `0.0` if empty.
+    pub fn mean(&self) -> f64 {
+        if self.count == 0 {
+            0.0
+        } else {
+            self.sum as f64 / self.count as f64
+        }
+    }
+
+    /// Upper bound of the bucket containing the `q`-quantile (`0.0 <= q <= 1.0`), capped at the
+    /// maximum value, or `0` if empty.
+    pub fn percentile(&self, q: f64) -> u64 {
+        if self.count == 0 {
+            return 0;
+        }
+        let rank = ((self.count as f64 * q.clamp(0.0, 1.0)).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (k, &n) in self.buckets.iter().enumerate() {
+            seen += n;
+            if seen >= rank {
+                return bucket_upper(k).min(self.max);
+            }
+        }
+        self.max
+    }
+}
+
+#[derive(Debug)]
+struct AtomicHistogram {
+    count: AtomicU64,
+    sum: AtomicU64,
+    max: AtomicU64,
+    buckets: [AtomicU64; BUCKETS],
+}
+
+impl AtomicHistogram {
+    fn new() -> Self {
+        Self {
+            count: AtomicU64::new(0),
+            sum: AtomicU64::new(0),
+            max: AtomicU64::new(0),
+            buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+        }
+    }
+
+    fn record(&self, value: u64) {
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum.fetch_add(value, Ordering::Relaxed);
+        self.max.fetch_max(value, Ordering::Relaxed);
+        self.buckets[bucket(value)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> Histogram {
+        Histogram {
+            count: self.count.load(Ordering::Relaxed),
+            sum: self.sum.load(Ordering::Relaxed),
+            max: self.max.load(Ordering::Relaxed),
+            buckets: std::array::from_fn(|k| self.buckets[k].load(Ordering::Relaxed)),
+        }
+    }
+
+    fn reset(&self) {
+        self.count.store(0, Ordering::Relaxed);
+        self.sum.store(0, Ordering::Relaxed);
+        self.max.store(0, Ordering::Relaxed);
+        for b in &self.buckets {
+            b.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// [`MetricsSink`] keeping one lock-free [`Histogram`] per [`Metric`].
+#[derive(Debug)]
+pub struct HistogramSink {
+    histograms: [AtomicHistogram; Metric::ALL.len()],
+}
+
+impl Default for HistogramSink {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl HistogramSink {
+    pub fn new() -> Self {
+        Self {
+            histograms: std::array::from_fn(|_| AtomicHistogram::new()),
+        }
+    }
+
+    /// Snapshot of the histogram of `metric`.
+    pub fn histogram(&self, metric: Metric) -> Histogram {
+        self.histograms[metric as usize].snapshot()
+    }
+
+    /// Clears all the histograms.
+    pub fn reset(&self) {
+        for h in &self.histograms {
+            h.reset();
+        }
+    }
+}
+
+impl MetricsSink for HistogramSink {
+    #[inline]
+    fn record(&self, metric: Metric, value: u64) {
+        self.histograms[metric as usize].record(value);
+    }
+}
+
+#[cfg(feature = "cmecab")]
+mod lattice_stats {
+    use super::{lattice_stats_enabled, record, Metric};
+    use crate::ffi::Lattice;
+
+    impl Lattice<'_> {
+        /// Records the node counts of the parsed lattice if lattice metrics are enabled.
+        pub(crate) fn record_stats(&self) {
+            if lattice_stats_enabled() {
+                let stats = self.stats();
+                record(Metric::LatticeNodes, stats.nodes as u64);
+                record(Metric::UnknownNodes, stats.unknown_nodes as u64);
+                record(Metric::BestPathNodes, stats.best_path_nodes as u64);
+                record(Metric::LatticeBytes, stats.bytes as u64);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+use std::fs::File;
+use std::io;
+use std::ops::Deref;
+use std::os::unix::io::AsRawFd;
+use std::path::Path;
+use std::ptr::NonNull;
+
+/// Read-only memory map of a whole file.
+///
+/// It dereferences to `[u8]`, so it can be passed to [`TokenStream`](crate::TokenStream) as a
+/// [`BufRead`](std::io::BufRead) (`&[u8]`) without copying lines.
+///
+/// ```no_run
+/// use mecab_wrapper::MmapFile;
+///
+/// # fn test() -> std::io::Result<()> {
+/// let file = MmapFile::open("corpus.txt")?;
+/// let lines = file.split(|&b| b == b'\n').count();
+/// # Ok(())
+/// # }
+/// ```
+#[derive(Debug)]
+pub struct MmapFile {
+    ptr: NonNull<u8>,
+    len: usize,
+}
+
+unsafe impl Send for MmapFile {}
+unsafe impl Sync for MmapFile {}
+
+impl MmapFile {
+    /// Maps the file at `path`.
+    pub fn open<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        let file = File::open(path)?;
+        Self::from_file(&file)
+    }
+
+    /// Maps `file`. The file may be closed after this call.
+    pub fn from_file(file: &File) -> io::Result<Self> {
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            return Ok(Self {
+                ptr: NonNull::dangling(),
+                len,
+            });
+        }
+
+        unsafe {
+            let ptr = libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            );
+            if ptr == libc::MAP_FAILED {
+                return Err(io::Error::last_os_error());
+            }
+            libc::madvise(ptr, len, libc::MADV_SEQUENTIAL);
+
+            Ok(Self {
+                ptr: NonNull::new_unchecked(ptr as *mut u8),
+                len,
+            })
+        }
+    }
+}
+
+impl Deref for MmapFile {
+    type Target = [u8];
+
+    #[inline]
+    fn deref(&self) -> &Self::Target {
+        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.len) }
+    }
+}
+
+impl AsRef<[u8]> for MmapFile {
+    #[inline]
+    fn as_ref(&self) -> &[u8] {
+        self
+    }
+}
+
+impl Drop for MmapFile {
+    fn drop(&mut self) {
+        if self.len != 0 {
+            unsafe {
+                libc::munmap(self.ptr.as_ptr() as _, self.len);
+            }
+        }
+    }
+}
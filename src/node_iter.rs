@@ -1,4 +1,9 @@
-use crate::ffi::{Lattice, Node};
+use crate::ffi::{Lattice, Node, NodeStatus};
+use crate::SentenceIndex;
+
+use libc::c_ushort;
+
+use std::iter::FusedIterator;
 
 /// Iterates nodes forward.
 ///
@@ -150,6 +155,229 @@ impl<'a> NodeIter<'a> {
     }
 }
 
+impl<'a> NodeIter<'a> {
+    /// Skips BOS and stops at EOS, yielding the tokens of the path. See [`BestTokens`].
+    #[inline]
+    pub fn best_tokens(self) -> BestTokens<'a> {
+        BestTokens { node: self.node }
+    }
+}
+
+/// Set of `posid`s, represented as a bitset of `64 * N` bits so that the membership test is a
+/// shift and a mask. The default `N` covers the posids below 256, which is enough for IPADIC.
+///
+/// A set can be built in a `const`, to filter nodes with [`BestTokens::filter_posid()`]:
+///
+/// ```no_run
+/// use mecab_wrapper::PosidSet;
+///
+/// // Nouns of IPADIC (pos-id.def).
+/// const NOUNS: PosidSet = PosidSet::new().with_range(36, 67);
+/// assert!(NOUNS.contains(38));
+/// assert!(!NOUNS.contains(13));
+/// ```
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct PosidSet<const N: usize = 4> {
+    words: [u64; N],
+}
+
+impl<const N: usize> Default for PosidSet<N> {
+    #[inline]
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl<const N: usize> PosidSet<N> {
+    /// The number of posids a set can hold: it holds the posids below `CAPACITY`.
+    pub const CAPACITY: usize = 64 * N;
+
+    /// An empty set.
+    #[inline]
+    pub const fn new() -> Self {
+        Self { words: [0; N] }
+    }
+
+    /// The set of `posids`.
+    ///
+    /// # Panics
+    /// Panics (at compile time in a `const`) if a posid is not below [`Self::CAPACITY`].
+    pub const fn from_slice(posids: &[c_ushort]) -> Self {
+        let mut set = Self::new();
+        let mut i = 0;
+        while i < posids.len() {
+            set = set.with(posids[i]);
+            i += 1;
+        }
+        set
+    }
+
+    /// Adds `posid` to `self`.
+    ///
+    /// # Panics
+    /// Panics (at compile time in a `const`) if `posid` is not below [`Self::CAPACITY`].
+    #[inline]
+    pub const fn with(mut self, posid: c_ushort) -> Self {
+        let posid = posid as usize;
+        assert!(
+            posid < Self::CAPACITY,
+            "posid out of the capacity of PosidSet"
+        );
+        self.words[posid / 64] |= 1 << (posid % 64);
+        self
+    }
+
+    /// Adds the posids from `first` to `last`, both inclusive, to `self`.
+    ///
+    /// # Panics
+    /// Same as [`Self::with()`].
+    pub const fn with_range(mut self, first: c_ushort, last: c_ushort) -> Self {
+        let mut posid = first;
+        while posid < last {
+            self = self.with(posid);
+            posid += 1;
+        }
+        if first <= last {
+            self = self.with(last);
+        }
+        self
+    }
+
+    /// Adds `posid` to `self`.
+    ///
+    /// # Panics
+    /// Same as [`Self::with()`].
+    #[inline]
+    pub fn insert(&mut self, posid: c_ushort) {
+        *self = self.with(posid);
+    }
+
+    /// Returns true if `posid` is in `self`. Posids not below [`Self::CAPACITY`] are not.
+    #[inline]
+    pub const fn contains(&self, posid: c_ushort) -> bool {
+        let posid = posid as usize;
+        posid < Self::CAPACITY && self.words[posid / 64] & (1 << (posid % 64)) != 0
+    }
+}
+
+/// Iterates the tokens of a path, i.e., the nodes from BOS to EOS, both excluded. It is returned
+/// by [`NodeIter::best_tokens()`] or [`Lattice::best_tokens()`].
+///
+/// `BestTokens` and the iterators built on it only follow [`Node::next()`] and read the fields
+/// of the nodes in place, so a pipeline such as
+/// `best_tokens().filter_posid(set).surfaces(&index)` runs in one pass over the path, with
+/// neither allocation nor FFI call.
+///
+/// ```no_run
+/// use mecab_wrapper::{Lattice, PosidSet};
+///
+/// const CONTENT_WORDS: PosidSet = PosidSet::new().with_range(10, 12).with_range(31, 67);
+///
+/// # fn test(lattice: &Lattice<'_>) {
+/// let index = lattice.sentence_index().unwrap();
+/// for surface in lattice.best_tokens().filter_posid(CONTENT_WORDS).surfaces(&index) {
+///     println!("{surface}");
+/// }
+/// # }
+/// ```
+#[derive(Debug, Clone)]
+pub struct BestTokens<'a> {
+    node: Option<&'a Node>,
+}
+
+impl<'a> Iterator for BestTokens<'a> {
+    type Item = &'a Node;
+
+    #[inline]
+    fn next(&mut self) -> Option<Self::Item> {
+        loop {
+            let node = self.node?;
+            self.node = node.next();
+            match node.status() {
+                NodeStatus::Bos => continue,
+                NodeStatus::Eos | NodeStatus::EoNbest => {
+                    self.node = None;
+                    return None;
+                }
+                _ => return Some(node),
+            }
+        }
+    }
+}
+
+impl<'a> FusedIterator for BestTokens<'a> {}
+
+impl<'a> BestTokens<'a> {
+    /// Yields only the tokens whose [`Node::posid`] is in `set`.
+    #[inline]
+    pub fn filter_posid<const N: usize>(self, set: PosidSet<N>) -> FilterPosid<'a, N> {
+        FilterPosid { tokens: self, set }
+    }
+
+    /// Yields the surfaces of the tokens. See [`Surfaces`].
+    #[inline]
+    pub fn surfaces<'s>(self, index: &'s SentenceIndex<'a>) -> Surfaces<'a, 's, Self> {
+        Surfaces { nodes: self, index }
+    }
+}
+
+/// Tokens whose `posid` is in a [`PosidSet`], returned by [`BestTokens::filter_posid()`].
+#[derive(Debug, Clone)]
+pub struct FilterPosid<'a, const N: usize = 4> {
+    tokens: BestTokens<'a>,
+    set: PosidSet<N>,
+}
+
+impl<'a, const N: usize> Iterator for FilterPosid<'a, N> {
+    type Item = &'a Node;
+
+    #[inline]
+    fn next(&mut self) -> Option<Self::Item> {
+        let set = &self.set;
+        self.tokens.find(|node| set.contains(node.posid))
+    }
+}
+
+impl<'a, const N: usize> FusedIterator for FilterPosid<'a, N> {}
+
+impl<'a, const N: usize> FilterPosid<'a, N> {
+    /// Yields the surfaces of the tokens. See [`Surfaces`].
+    #[inline]
+    pub fn surfaces<'s>(self, index: &'s SentenceIndex<'a>) -> Surfaces<'a, 's, Self> {
+        Surfaces { nodes: self, index }
+    }
+}
+
+/// Surfaces of nodes as `&str`, returned by [`BestTokens::surfaces()`] and
+/// [`FilterPosid::surfaces()`].
+///
+/// The sentence is validated as UTF-8 once by the [`SentenceIndex`], so a surface is sliced out
+/// of it with bounds checks only, instead of validating every surface as in
+/// [`Node::surface_str()`]. A node not on character boundaries of the sentence, which MeCab with
+/// a UTF-8 dictionary never produces, is skipped.
+#[derive(Debug, Clone)]
+pub struct Surfaces<'a, 's, I> {
+    nodes: I,
+    index: &'s SentenceIndex<'a>,
+}
+
+impl<'a, 's, I: Iterator<Item = &'a Node>> Iterator for Surfaces<'a, 's, I> {
+    type Item = &'a str;
+
+    #[inline]
+    fn next(&mut self) -> Option<Self::Item> {
+        let index = self.index;
+        self.nodes.find_map(|node| index.surface(node))
+    }
+
+    #[inline]
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        (0, self.nodes.size_hint().1)
+    }
+}
+
+impl<'a, 's, I: FusedIterator<Item = &'a Node>> FusedIterator for Surfaces<'a, 's, I> {}
+
 /// Iterates nodes backward.
 ///
 /// The iterations below are equivalent:
@@ -299,3 +527,175 @@ impl<'a> NodeRevIter<'a> {
         Self { node }
     }
 }
+
+/// Enumerates the N-best paths of a lattice one by one, without rendering them to strings.
+///
+/// This is a lending iterator: each call of [`NbestIter::next()`] asks MeCab for the next best
+/// path ([`Lattice::next_nbest()`]) and returns a [`NodeIter`] over it from BOS to EOS. The
+/// returned iterator borrows `self`, so it must be dropped before the next call. Paths are
+/// generated only on demand; stop calling `next()` to skip the rest.
+///
+/// The lattice must be parsed with [`RequestType::N_BEST`](crate::RequestType::N_BEST).
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, NbestIter, RequestType, Tagger};
+/// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>) {
+/// lattice.set_request_type(RequestType::N_BEST);
+/// lattice.set_sentence("すもももももももものうち");
+/// tagger.parse(lattice);
+///
+/// let mut paths = NbestIter::new(lattice);
+/// while let Some(path) = paths.next() {
+///     let surfaces: Vec<_> = path.map(|node| node.surface()).collect();
+///     println!("{surfaces:?}");
+///     if paths.rank() == 5 {
+///         break;
+///     }
+/// }
+/// # }
+/// ```
+pub struct NbestIter<'a, 'm> {
+    lattice: &'a mut Lattice<'m>,
+    rank: usize,
+}
+
+impl<'a, 'm> NbestIter<'a, 'm> {
+    /// Starts enumerating the paths of `lattice`, which has just been parsed.
+    #[inline]
+    pub fn new(lattice: &'a mut Lattice<'m>) -> Self {
+        Self { lattice, rank: 0 }
+    }
+
+    /// Returns the next best path, or `None` if there are no more paths.
+    ///
+    /// The first call returns the best path.
+    #[allow(clippy::should_implement_trait)]
+    pub fn next(&mut self) -> Option<NodeIter<'_>> {
+        if self.lattice.next_nbest().is_break() {
+            return None;
+        }
+        self.rank += 1;
+        Some(self.lattice.iter_nodes())
+    }
+
+    /// The number of paths returned so far.
+    #[inline]
+    pub fn rank(&self) -> usize {
+        self.rank
+    }
+
+    /// Returns the lattice, which holds the last returned path.
+    #[inline]
+    pub fn into_lattice(self) -> &'a mut Lattice<'m> {
+        self.lattice
+    }
+}
+
+/// Iterates the nodes beginning at the same position, following [`Node::bnext()`].
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, NodeBnextIter};
+/// # fn test(lattice: &Lattice<'_>) {
+/// // Word candidates starting at the 3rd byte.
+/// for node in lattice.nodes_at(3) {
+///     println!("{:?}", node.surface_str());
+/// }
+///
+/// // Same as above.
+/// for node in NodeBnextIter::from_node_option(lattice.begin_nodes(3)) {
+///     println!("{:?}", node.surface_str());
+/// }
+/// # }
+/// ```
+#[derive(Debug, Clone)]
+pub struct NodeBnextIter<'a> {
+    node: Option<&'a Node>,
+}
+
+impl<'a> Iterator for NodeBnextIter<'a> {
+    type Item = &'a Node;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let node = self.node?;
+        self.node = node.bnext();
+        Some(node)
+    }
+}
+
+impl<'a> NodeBnextIter<'a> {
+    /// Returns the current node (= the node which the next [`Iterator::next()`] will return).
+    #[inline]
+    pub fn get_node(&self) -> Option<&'a Node> {
+        self.node
+    }
+
+    /// Initializes with the given node.
+    #[inline]
+    pub fn from_node(node: &'a Node) -> Self {
+        Self { node: Some(node) }
+    }
+
+    /// This is identical with [`Self::from_node()`] or an empty iterator depending on the
+    /// `node` is `Some` or not.
+    #[inline]
+    pub fn from_node_option(node: Option<&'a Node>) -> Self {
+        Self { node }
+    }
+}
+
+/// Matches of a common prefix search, returned by
+/// [`Model::prefix_matches()`](crate::Model::prefix_matches()). MeCab chains them by
+/// [`Node::bnext()`] since they all begin at the same position.
+pub type PrefixMatches<'a> = NodeBnextIter<'a>;
+
+/// Iterates the nodes ending at the same position, following [`Node::enext()`].
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, NodeEnextIter};
+/// # fn test(lattice: &Lattice<'_>) {
+/// // Word candidates ending at the 3rd byte.
+/// for node in lattice.nodes_ending_at(3) {
+///     println!("{:?}", node.surface_str());
+/// }
+///
+/// // Same as above.
+/// for node in NodeEnextIter::from_node_option(lattice.end_nodes(3)) {
+///     println!("{:?}", node.surface_str());
+/// }
+/// # }
+/// ```
+#[derive(Debug, Clone)]
+pub struct NodeEnextIter<'a> {
+    node: Option<&'a Node>,
+}
+
+impl<'a> Iterator for NodeEnextIter<'a> {
+    type Item = &'a Node;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let node = self.node?;
+        self.node = node.enext();
+        Some(node)
+    }
+}
+
+impl<'a> NodeEnextIter<'a> {
+    /// Returns the current node (= the node which the next [`Iterator::next()`] will return).
+    #[inline]
+    pub fn get_node(&self) -> Option<&'a Node> {
+        self.node
+    }
+
+    /// Initializes with the given node.
+    #[inline]
+    pub fn from_node(node: &'a Node) -> Self {
+        Self { node: Some(node) }
+    }
+
+    /// This is identical with [`Self::from_node()`] or an empty iterator depending on the
+    /// `node` is `Some` or not.
+    #[inline]
+    pub fn from_node_option(node: Option<&'a Node>) -> Self {
+        Self { node }
+    }
+}
@@ -0,0 +1,558 @@
+use crate::ffi::{Attribute, DictionaryInfo, NodeStatus, TokenBuffer};
+
+use libc::{c_long, c_short, c_ushort};
+
+use std::collections::HashMap;
+use std::error::Error;
+use std::fmt;
+use std::ops::Range;
+
+const MAGIC: &[u8; 4] = b"MWT1";
+/// Magic, fingerprint, and the three counts of at most 10 bytes each.
+const MAX_HEADER: usize = 4 + 8 + 3 * 10;
+
+/// Error of [`PackedTokens::new()`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum DecodeError {
+    /// The input does not start with the magic number of this format.
+    BadMagic,
+    /// The input ends in the middle of the message.
+    Truncated,
+    /// A value is out of range, e.g. a feature id beyond the string table.
+    Invalid,
+}
+
+impl fmt::Display for DecodeError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str(match self {
+            Self::BadMagic => "not packed tokens",
+            Self::Truncated => "packed tokens are truncated",
+            Self::Invalid => "packed tokens are corrupted",
+        })
+    }
+}
+
+impl Error for DecodeError {}
+
+fn put_varint(out: &mut Vec<u8>, mut n: u64) {
+    while n >= 0x80 {
+        out.push(n as u8 | 0x80);
+        n >>= 7;
+    }
+    out.push(n as u8);
+}
+
+#[inline]
+fn zigzag(n: i64) -> u64 {
+    ((n << 1) ^ (n >> 63)) as u64
+}
+
+#[inline]
+fn unzigzag(n: u64) -> i64 {
+    (n >> 1) as i64 ^ -((n & 1) as i64)
+}
+
+/// Reads a varint at `*pos`, advancing it.
+#[inline]
+fn get_varint(data: &[u8], pos: &mut usize) -> Result<u64, DecodeError> {
+    let mut n = 0u64;
+    for shift in (0..64).step_by(7) {
+        let b = *data.get(*pos).ok_or(DecodeError::Truncated)?;
+        *pos += 1;
+        n |= ((b & 0x7f) as u64) << shift;
+        if b < 0x80 {
+            return Ok(n);
+        }
+    }
+    Err(DecodeError::Invalid)
+}
+
+#[inline]
+fn get_u16(data: &[u8], pos: &mut usize) -> Result<u16, DecodeError> {
+    u16::try_from(get_varint(data, pos)?).map_err(|_| DecodeError::Invalid)
+}
+
+#[inline]
+fn get_usize(data: &[u8], pos: &mut usize) -> Result<usize, DecodeError> {
+    usize::try_from(get_varint(data, pos)?).map_err(|_| DecodeError::Invalid)
+}
+
+impl DictionaryInfo {
+    /// Hash identifying the dictionaries of a model, to be stored with
+    /// [packed tokens](TokenBuffer::encode_packed()).
+    ///
+    /// It covers the charset, the numbers of words and attributes, the version, and the file name
+    /// (not the directory) of every dictionary in the list starting at `self`. It is stable across
+    /// processes and machines.
+    pub fn fingerprint(&self) -> u64 {
+        // FNV-1a, which unlike `DefaultHasher` is fixed.
+        let mut h = 0xcbf2_9ce4_8422_2325u64;
+        let mut write = |bytes: &[u8]| {
+            for &b in bytes {
+                h = (h ^ b as u64).wrapping_mul(0x100_0000_01b3);
+            }
+        };
+
+        let mut info = Some(self);
+        while let Some(dic) = info {
+            let filename = dic.filename();
+            let name = match filename.iter().rposition(|&b| b == b'/') {
+                Some(i) => &filename[i + 1..],
+                None => filename,
+            };
+            write(name);
+            write(&[0]);
+            write(dic.charset());
+            write(&[0, dic.dictionary_type() as u8]);
+            write(&dic.size.to_le_bytes());
+            write(&dic.lsize.to_le_bytes());
+            write(&dic.rsize.to_le_bytes());
+            write(&dic.version.to_le_bytes());
+            info = dic.next();
+        }
+        h
+    }
+}
+
+impl TokenBuffer {
+    /// Appends the tokens to `out` in a compact binary format, read by [`PackedTokens`].
+    ///
+    /// Each distinct feature string is stored once per message, and the tokens refer to it by
+    /// index. The other columns are stored as varints, with the surface offsets and the costs
+    /// delta-coded within each sentence. `fingerprint` is stored in the header; pass
+    /// [`DictionaryInfo::fingerprint()`] so that readers can check that the tokens come from
+    /// the same dictionaries, or `0`.
+    ///
+    /// ```no_run
+    /// # use mecab_wrapper::{Model, PackedTokens, TokenBuffer};
+    /// # fn test(model: &Model, tokens: &TokenBuffer) {
+    /// let fingerprint = model.dictionary_info().fingerprint();
+    /// let mut bytes = Vec::new();
+    /// tokens.encode_packed(fingerprint, &mut bytes);
+    ///
+    /// let packed = PackedTokens::new(&bytes).unwrap();
+    /// assert_eq!(packed.fingerprint(), fingerprint);
+    /// for token in packed.iter() {
+    ///     println!("{:?} {:?}", token.surface_range(), token.features());
+    /// }
+    /// # }
+    /// ```
+    pub fn encode_packed(&self, fingerprint: u64, out: &mut Vec<u8>) {
+        let mut ids = HashMap::new();
+        let mut strings = Vec::new();
+        let feature_ids: Vec<u32> = self
+            .tokens()
+            .map(|token| {
+                let feats = token.features();
+                *ids.entry(feats).or_insert_with(|| {
+                    strings.push(feats);
+                    strings.len() as u32 - 1
+                })
+            })
+            .collect();
+
+        out.reserve(MAX_HEADER + 4 * strings.len() + 8 * self.len());
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&fingerprint.to_le_bytes());
+        put_varint(out, self.sentence_count() as u64);
+        put_varint(out, self.len() as u64);
+        put_varint(out, strings.len() as u64);
+
+        // Fixed-width ends, so that the reader can index the table in place.
+        let mut end = 0u32;
+        for s in &strings {
+            end += s.len() as u32;
+            out.extend_from_slice(&end.to_le_bytes());
+        }
+        for s in &strings {
+            out.extend_from_slice(s);
+        }
+
+        for k in 0..self.sentence_count() {
+            let sentence = self.sentence(k).unwrap();
+            put_varint(out, sentence.len() as u64);
+            let (mut prev_end, mut prev_cost) = (0i64, 0i64);
+            for token in sentence {
+                let begin = token.surface_range().start as i64;
+                put_varint(out, zigzag(begin - prev_end));
+                put_varint(out, token.surface_len() as u64);
+                put_varint(out, token.posid() as u64);
+                put_varint(out, token.rattr().id() as u64);
+                put_varint(out, token.lattr().id() as u64);
+                put_varint(out, zigzag(token.wcost() as i64));
+                put_varint(out, zigzag(token.cost() as i64 - prev_cost));
+                out.push(token.status() as u8);
+                put_varint(out, feature_ids[token.index()] as u64);
+                prev_end = begin + token.surface_len() as i64;
+                prev_cost = token.cost() as i64;
+            }
+        }
+    }
+}
+
+/// Read-only view of tokens encoded by [`TokenBuffer::encode_packed()`].
+///
+/// [`PackedTokens::new()`] validates the whole message once, without allocating. The tokens are
+/// then decoded lazily by [`PackedTokens::iter()`], and their feature strings are borrowed from
+/// the message. Use [`PackedTokens::decode_into()`] to get a [`TokenBuffer`] back.
+#[derive(Debug, Clone, Copy)]
+pub struct PackedTokens<'a> {
+    fingerprint: u64,
+    sentences: usize,
+    tokens: usize,
+    /// `u32` little-endian end offsets into `strings`.
+    string_ends: &'a [u8],
+    strings: &'a [u8],
+    /// Sentence lengths and token rows.
+    rows: &'a [u8],
+}
+
+impl<'a> PackedTokens<'a> {
+    pub fn new(data: &'a [u8]) -> Result<Self, DecodeError> {
+        if data.len() < MAGIC.len() + 8 {
+            return Err(if data.starts_with(&MAGIC[..data.len().min(4)]) {
+                DecodeError::Truncated
+            } else {
+                DecodeError::BadMagic
+            });
+        }
+        if &data[..4] != MAGIC {
+            return Err(DecodeError::BadMagic);
+        }
+        let fingerprint = u64::from_le_bytes(data[4..12].try_into().unwrap());
+
+        let mut pos = 12;
+        let sentences = get_usize(data, &mut pos)?;
+        let tokens = get_usize(data, &mut pos)?;
+        let n_strings = get_usize(data, &mut pos)?;
+
+        let table_end = n_strings
+            .checked_mul(4)
+            .and_then(|n| n.checked_add(pos))
+            .ok_or(DecodeError::Invalid)?;
+        let string_ends = data.get(pos..table_end).ok_or(DecodeError::Truncated)?;
+        pos = table_end;
+        let mut prev = 0;
+        for end in string_ends.chunks_exact(4) {
+            let end = u32::from_le_bytes(end.try_into().unwrap()) as usize;
+            if end < prev {
+                return Err(DecodeError::Invalid);
+            }
+            prev = end;
+        }
+        let strings = data.get(pos..pos + prev).ok_or(DecodeError::Truncated)?;
+        pos += prev;
+
+        let packed = Self {
+            fingerprint,
+            sentences,
+            tokens,
+            string_ends,
+            strings,
+            rows: &data[pos..],
+        };
+
+        let mut seen = 0;
+        let mut rows = 0;
+        for _ in 0..sentences {
+            let len = get_usize(packed.rows, &mut rows)?;
+            // The offsets and costs `PackedIter` accumulates must not overflow.
+            let (mut prev_end, mut prev_cost) = (0i64, 0i64);
+            for _ in 0..len {
+                let row = Row::read(packed.rows, &mut rows)?;
+                if row.feature as usize >= n_strings {
+                    return Err(DecodeError::Invalid);
+                }
+                let begin = prev_end
+                    .checked_add(row.begin_delta)
+                    .filter(|&begin| begin >= 0 && usize::try_from(begin).is_ok())
+                    .ok_or(DecodeError::Invalid)?;
+                prev_end = begin
+                    .checked_add(row.length as i64)
+                    .ok_or(DecodeError::Invalid)?;
+                prev_cost = prev_cost
+                    .checked_add(row.cost_delta)
+                    .filter(|&cost| c_long::try_from(cost).is_ok())
+                    .ok_or(DecodeError::Invalid)?;
+            }
+            seen += len;
+        }
+        if seen != tokens || rows != packed.rows.len() {
+            return Err(DecodeError::Invalid);
+        }
+        Ok(packed)
+    }
+
+    /// The fingerprint passed to [`TokenBuffer::encode_packed()`].
+    #[inline]
+    pub fn fingerprint(&self) -> u64 {
+        self.fingerprint
+    }
+
+    /// The number of tokens in all the sentences.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.tokens
+    }
+
+    /// Returns true if there are no tokens.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.tokens == 0
+    }
+
+    #[inline]
+    pub fn sentence_count(&self) -> usize {
+        self.sentences
+    }
+
+    /// The number of distinct feature strings.
+    #[inline]
+    pub fn feature_count(&self) -> usize {
+        self.string_ends.len() / 4
+    }
+
+    /// The `id`-th distinct feature string. It returns `None` if the index is out-of-bound.
+    pub fn feature(&self, id: usize) -> Option<&'a [u8]> {
+        let end_at = |i: usize| {
+            let b = &self.string_ends[4 * i..4 * i + 4];
+            u32::from_le_bytes(b.try_into().unwrap()) as usize
+        };
+        if id >= self.feature_count() {
+            return None;
+        }
+        let begin = if id == 0 { 0 } else { end_at(id - 1) };
+        Some(&self.strings[begin..end_at(id)])
+    }
+
+    /// Returns an iterator of the tokens of all the sentences.
+    #[inline]
+    pub fn iter(&self) -> PackedIter<'a> {
+        PackedIter {
+            packed: *self,
+            pos: 0,
+            sentences: 0,
+            remaining: 0,
+            prev_end: 0,
+            prev_cost: 0,
+            index: 0,
+        }
+    }
+
+    /// Decodes the tokens into `tokens`, which is cleared first.
+    pub fn decode_into(&self, tokens: &mut TokenBuffer) {
+        tokens.clear();
+        let mut sentence = 0;
+        for token in self.iter() {
+            while token.sentence > sentence {
+                tokens.close_sentence();
+                sentence += 1;
+            }
+            tokens.push_token(
+                token.begin,
+                token.row.length,
+                token.row.posid,
+                Attribute(token.row.rattr),
+                Attribute(token.row.lattr),
+                token.row.wcost,
+                token.cost,
+                token.row.stat,
+                token.features(),
+            );
+        }
+        while sentence < self.sentences {
+            tokens.close_sentence();
+            sentence += 1;
+        }
+    }
+}
+
+impl<'a> IntoIterator for &PackedTokens<'a> {
+    type Item = PackedToken<'a>;
+    type IntoIter = PackedIter<'a>;
+
+    #[inline]
+    fn into_iter(self) -> Self::IntoIter {
+        self.iter()
+    }
+}
+
+/// A token row as stored, before the deltas are resolved.
+#[derive(Debug, Clone, Copy)]
+struct Row {
+    begin_delta: i64,
+    length: c_ushort,
+    posid: c_ushort,
+    rattr: c_ushort,
+    lattr: c_ushort,
+    wcost: c_short,
+    cost_delta: i64,
+    stat: u8,
+    feature: u32,
+}
+
+impl Row {
+    fn read(data: &[u8], pos: &mut usize) -> Result<Self, DecodeError> {
+        let begin_delta = unzigzag(get_varint(data, pos)?);
+        let length = get_u16(data, pos)?;
+        let posid = get_u16(data, pos)?;
+        let rattr = get_u16(data, pos)?;
+        let lattr = get_u16(data, pos)?;
+        let wcost = c_short::try_from(unzigzag(get_varint(data, pos)?))
+            .map_err(|_| DecodeError::Invalid)?;
+        let cost_delta = unzigzag(get_varint(data, pos)?);
+        let stat = *data.get(*pos).ok_or(DecodeError::Truncated)?;
+        *pos += 1;
+        if stat > NodeStatus::EoNbest as u8 {
+            return Err(DecodeError::Invalid);
+        }
+        let feature = u32::try_from(get_varint(data, pos)?).map_err(|_| DecodeError::Invalid)?;
+        Ok(Self {
+            begin_delta,
+            length,
+            posid,
+            rattr,
+            lattr,
+            wcost,
+            cost_delta,
+            stat,
+            feature,
+        })
+    }
+}
+
+/// Iterator of [`PackedToken`]s, returned by [`PackedTokens::iter()`].
+#[derive(Debug, Clone)]
+pub struct PackedIter<'a> {
+    packed: PackedTokens<'a>,
+    pos: usize,
+    /// The number of sentence headers read.
+    sentences: usize,
+    /// Tokens left in the current sentence.
+    remaining: usize,
+    prev_end: i64,
+    prev_cost: i64,
+    index: usize,
+}
+
+impl<'a> Iterator for PackedIter<'a> {
+    type Item = PackedToken<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let rows = self.packed.rows;
+        while self.remaining == 0 {
+            if self.pos == rows.len() {
+                return None;
+            }
+            // Validated by `PackedTokens::new()`.
+            self.remaining = get_usize(rows, &mut self.pos).unwrap();
+            self.sentences += 1;
+            self.prev_end = 0;
+            self.prev_cost = 0;
+        }
+
+        // Validated by `PackedTokens::new()`, including the sums below.
+        let row = Row::read(rows, &mut self.pos).unwrap();
+        let begin = self.prev_end + row.begin_delta;
+        let cost = self.prev_cost + row.cost_delta;
+        self.prev_end = begin + row.length as i64;
+        self.prev_cost = cost;
+        self.remaining -= 1;
+        self.index += 1;
+
+        Some(PackedToken {
+            packed: self.packed,
+            index: self.index - 1,
+            sentence: self.sentences - 1,
+            begin: begin as usize,
+            cost: cost as c_long,
+            row,
+        })
+    }
+
+    #[inline]
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        let n = self.packed.tokens - self.index;
+        (n, Some(n))
+    }
+}
+
+impl<'a> ExactSizeIterator for PackedIter<'a> {}
+
+/// A token of [`PackedTokens`]. Its methods mirror those of [`Token`](crate::Token).
+#[derive(Debug, Clone, Copy)]
+pub struct PackedToken<'a> {
+    packed: PackedTokens<'a>,
+    index: usize,
+    sentence: usize,
+    begin: usize,
+    cost: c_long,
+    row: Row,
+}
+
+impl<'a> PackedToken<'a> {
+    /// Index of `self` among all the tokens.
+    #[inline]
+    pub fn index(self) -> usize {
+        self.index
+    }
+
+    /// Index of the sentence containing `self`.
+    #[inline]
+    pub fn sentence(self) -> usize {
+        self.sentence
+    }
+
+    /// Byte range of the surface string in the parsed sentence.
+    #[inline]
+    pub fn surface_range(self) -> Range<usize> {
+        self.begin..self.begin + self.row.length as usize
+    }
+
+    #[inline]
+    pub fn surface_len(self) -> usize {
+        self.row.length as _
+    }
+
+    #[inline]
+    pub fn posid(self) -> c_ushort {
+        self.row.posid
+    }
+
+    #[inline]
+    pub fn rattr(self) -> Attribute {
+        Attribute(self.row.rattr)
+    }
+
+    #[inline]
+    pub fn lattr(self) -> Attribute {
+        Attribute(self.row.lattr)
+    }
+
+    #[inline]
+    pub fn wcost(self) -> c_short {
+        self.row.wcost
+    }
+
+    #[inline]
+    pub fn cost(self) -> c_long {
+        self.cost
+    }
+
+    #[inline]
+    pub fn status(self) -> NodeStatus {
+        NodeStatus::from_stat(self.row.stat)
+    }
+
+    /// Index of the feature string in [`PackedTokens::feature()`].
+    #[inline]
+    pub fn feature_id(self) -> usize {
+        self.row.feature as _
+    }
+
+    /// Feature string, borrowed from the message.
+    #[inline]
+    pub fn features(self) -> &'a [u8] {
+        self.packed.feature(self.feature_id()).unwrap()
+    }
+}
@@ -0,0 +1,204 @@
+use crate::ffi::{Model, TokenBuffer, Tokens};
+
+use std::collections::BTreeMap;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::mpsc;
+use std::sync::Mutex;
+
+/// In which order [`Model::parse_parallel()`] passes the results to the sink.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum OutputOrder {
+    /// Same order as the input.
+    Input,
+    /// As soon as each chunk is parsed.
+    Unordered,
+}
+
+/// Options of [`Model::parse_parallel()`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct ParallelOptions {
+    /// The number of worker threads.
+    pub threads: usize,
+    /// The number of sentences a worker takes from the input at once.
+    pub chunk_size: usize,
+    /// Order of the results.
+    pub order: OutputOrder,
+    /// The number of chunks that may be parsed but not passed to the sink yet, per thread. The
+    /// workers wait when this limit is reached.
+    pub chunks_in_flight: usize,
+}
+
+impl Default for ParallelOptions {
+    fn default() -> Self {
+        let threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+        Self::new(threads)
+    }
+}
+
+impl ParallelOptions {
+    /// Options for `threads` workers with the default chunk size, in [`OutputOrder::Input`].
+    pub fn new(threads: usize) -> Self {
+        Self {
+            threads: threads.max(1),
+            chunk_size: 64,
+            order: OutputOrder::Input,
+            chunks_in_flight: 2,
+        }
+    }
+
+    /// Sets [`ParallelOptions::order`].
+    #[inline]
+    pub fn order(mut self, order: OutputOrder) -> Self {
+        self.order = order;
+        self
+    }
+
+    /// Sets [`ParallelOptions::chunk_size`].
+    #[inline]
+    pub fn chunk_size(mut self, chunk_size: usize) -> Self {
+        self.chunk_size = chunk_size.max(1);
+        self
+    }
+}
+
+struct Chunk<'i> {
+    first: usize,
+    inputs: Vec<&'i str>,
+    tokens: TokenBuffer,
+}
+
+impl Model {
+    /// Tokenizes `input` on `options.threads` worker threads sharing `self`.
+    ///
+    /// All the workers share one [`Tagger`](crate::Tagger), and each owns its own
+    /// [`Lattice`](crate::Lattice). An idle worker takes the next
+    /// [`chunk_size`](ParallelOptions::chunk_size) sentences from `input`, parses them with
+    /// [`Tagger::parse_batch()`](crate::Tagger::parse_batch()), and hands the tokens to the
+    /// calling thread, which calls `sink(index, sentence, tokens)` for each sentence. Busy workers
+    /// never wait for each other, so the load is balanced dynamically.
+    ///
+    /// Token buffers are recycled between the workers and the sink, and at most
+    /// `threads * chunks_in_flight` chunks exist at once. If the sink is slow the workers wait, so
+    /// the memory is bounded regardless of the input size.
+    ///
+    /// Returns false if the tagger cannot be created or some sentence cannot be parsed. In the
+    /// latter case, the workers stop pulling the input, and the sentences not parsed are not
+    /// passed to the sink.
+    ///
+    /// ```no_run
+    /// use mecab_wrapper::{Model, OutputOrder, ParallelOptions};
+    ///
+    /// # fn test(model: &Model, corpus: &str) {
+    /// let options = ParallelOptions::new(8).order(OutputOrder::Unordered);
+    /// let ok = model.parse_parallel(corpus.lines(), options, |i, sentence, tokens| {
+    ///     for token in tokens {
+    ///         println!("{i}: {}", &sentence[token.surface_range()]);
+    ///     }
+    /// });
+    /// assert!(ok);
+    /// # }
+    /// ```
+    pub fn parse_parallel<'i, I, S>(&self, input: I, options: ParallelOptions, mut sink: S) -> bool
+    where
+        I: Iterator<Item = &'i str> + Send,
+        S: FnMut(usize, &'i str, Tokens<'_>),
+    {
+        let tagger = if let Some(tagger) = self.create_tagger() {
+            tagger
+        } else {
+            return false;
+        };
+
+        let threads = options.threads.max(1);
+        let chunk_size = options.chunk_size.max(1);
+        let chunks = threads * options.chunks_in_flight.max(1);
+
+        let input = Mutex::new((input, 0));
+        let failed = AtomicBool::new(false);
+
+        let (free_tx, free_rx) = mpsc::sync_channel::<Chunk<'i>>(chunks);
+        for _ in 0..chunks {
+            let chunk = Chunk {
+                first: 0,
+                inputs: Vec::with_capacity(chunk_size),
+                tokens: TokenBuffer::new(),
+            };
+            free_tx.send(chunk).unwrap();
+        }
+        let free_rx = Mutex::new(free_rx);
+        let (done_tx, done_rx) = mpsc::sync_channel::<Chunk<'i>>(chunks);
+
+        std::thread::scope(|s| {
+            for _ in 0..threads {
+                let done_tx = done_tx.clone();
+                let (tagger, input, failed, free_rx) = (&tagger, &input, &failed, &free_rx);
+
+                s.spawn(move || {
+                    let mut lattice = self.create_lattice();
+                    loop {
+                        let chunk = free_rx.lock().unwrap().recv();
+                        let mut chunk = if let Ok(chunk) = chunk {
+                            chunk
+                        } else {
+                            return;
+                        };
+
+                        chunk.inputs.clear();
+                        if !failed.load(Ordering::Relaxed) {
+                            let mut input = input.lock().unwrap();
+                            chunk.first = input.1;
+                            chunk.inputs.extend(input.0.by_ref().take(chunk_size));
+                            input.1 += chunk.inputs.len();
+                        }
+                        if chunk.inputs.is_empty() {
+                            return;
+                        }
+
+                        let ok = tagger.parse_batch(&mut lattice, &chunk.inputs, &mut chunk.tokens);
+                        if !ok {
+                            failed.store(true, Ordering::Relaxed);
+                        }
+                        if done_tx.send(chunk).is_err() {
+                            return;
+                        }
+                    }
+                });
+            }
+            drop(done_tx);
+
+            let mut emit = |chunk: Chunk<'i>| {
+                let sentences = chunk.inputs.iter().zip(chunk.tokens.sentences());
+                for (i, (sentence, tokens)) in sentences.enumerate() {
+                    sink(chunk.first + i, sentence, tokens);
+                }
+                // Never blocks: there are never more chunks than the capacity.
+                let _ = free_tx.try_send(chunk);
+            };
+
+            match options.order {
+                OutputOrder::Unordered => {
+                    for chunk in done_rx {
+                        emit(chunk);
+                    }
+                }
+                OutputOrder::Input => {
+                    let mut pending = BTreeMap::new();
+                    let mut next = 0;
+                    for chunk in done_rx {
+                        pending.insert(chunk.first, chunk);
+                        while let Some(chunk) = pending.remove(&next) {
+                            next += chunk.inputs.len();
+                            emit(chunk);
+                        }
+                    }
+                    // Chunks after a failed sentence.
+                    for (_, chunk) in pending {
+                        emit(chunk);
+                    }
+                }
+            }
+        });
+
+        !failed.load(Ordering::Relaxed)
+    }
+}
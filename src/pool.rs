@@ -0,0 +1,168 @@
+use crate::ffi::{Lattice, Model, Tagger};
+
+use std::cell::Cell;
+use std::ops::{Deref, DerefMut};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+
+static NEXT_THREAD_SLOT: AtomicUsize = AtomicUsize::new(0);
+
+thread_local! {
+    static THREAD_SLOT: Cell<Option<usize>> = const { Cell::new(None) };
+}
+
+/// A slot number assigned to each thread on first use, spreading threads over the shards.
+fn thread_slot() -> usize {
+    THREAD_SLOT.with(|slot| match slot.get() {
+        Some(n) => n,
+        None => {
+            let n = NEXT_THREAD_SLOT.fetch_add(1, Ordering::Relaxed);
+            slot.set(Some(n));
+            n
+        }
+    })
+}
+
+/// Thread-safe pool of [`Lattice`]s created by [`Model::pool()`].
+///
+/// Idle lattices are kept in shards, one per core at most. Each thread takes lattices from and
+/// returns them to its own shard, and steals from the other shards only when its shard is empty,
+/// so threads rarely contend for the same lock. When all the shards are empty, a new lattice is
+/// created and joins the pool when returned.
+///
+/// [`LatticePool::get()`] returns a [`PooledLattice`], which goes back to the pool after being
+/// [cleared](Lattice::clear()) when dropped. Lattices are thus reused across requests instead of
+/// being created and destroyed every time.
+///
+/// There is no tagger pool: a [`Tagger`] is `Sync` and can be shared by all the threads.
+///
+/// ```no_run
+/// use mecab_wrapper::{Model, Tagger};
+///
+/// # fn test(model: &Model, tagger: &Tagger<'_>, inputs: &[&str]) {
+/// let pool = model.pool(8);
+/// pool.warm_up(tagger, "東京都に住む");
+///
+/// std::thread::scope(|s| {
+///     for input in inputs {
+///         let pool = &pool;
+///         s.spawn(move || {
+///             let mut lattice = pool.get();
+///             lattice.set_sentence(input);
+///             if tagger.parse(&mut lattice) {
+///                 println!("{}", lattice.to_str().unwrap());
+///             }
+///         });
+///     }
+/// });
+/// # }
+/// ```
+pub struct LatticePool<'m> {
+    model: &'m Model,
+    shards: Box<[Mutex<Vec<Lattice<'m>>>]>,
+}
+
+impl Model {
+    /// Creates a pool of `n` lattices. See [`LatticePool`].
+    pub fn pool(&self, n: usize) -> LatticePool<'_> {
+        let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+        let shards = (0..cores.min(n).max(1))
+            .map(|_| Mutex::new(Vec::new()))
+            .collect::<Box<[_]>>();
+
+        for i in 0..n {
+            let lattice = self.create_lattice();
+            shards[i % shards.len()].lock().unwrap().push(lattice);
+        }
+
+        LatticePool {
+            model: self,
+            shards,
+        }
+    }
+}
+
+impl<'m> LatticePool<'m> {
+    #[inline]
+    fn home(&self) -> usize {
+        thread_slot() % self.shards.len()
+    }
+
+    /// Takes an idle lattice, or creates a new one if there are none.
+    pub fn get(&self) -> PooledLattice<'_, 'm> {
+        let home = self.home();
+        let lattice = self
+            .take(home)
+            .unwrap_or_else(|| self.model.create_lattice());
+        PooledLattice {
+            pool: self,
+            home,
+            lattice: Some(lattice),
+        }
+    }
+
+    fn take(&self, home: usize) -> Option<Lattice<'m>> {
+        if let Some(lattice) = self.shards[home].lock().unwrap().pop() {
+            return Some(lattice);
+        }
+
+        let n = self.shards.len();
+        (1..n).find_map(|i| {
+            let shard = self.shards[(home + i) % n].try_lock().ok();
+            shard.and_then(|mut shard| shard.pop())
+        })
+    }
+
+    /// The number of idle lattices.
+    pub fn idle(&self) -> usize {
+        self.shards.iter().map(|s| s.lock().unwrap().len()).sum()
+    }
+
+    /// Parses `sentence` once in every idle lattice, so that their internal buffers are allocated
+    /// before the first request.
+    pub fn warm_up(&self, tagger: &Tagger<'_>, sentence: &str) {
+        for shard in self.shards.iter() {
+            for lattice in shard.lock().unwrap().iter_mut() {
+                lattice.set_sentence(sentence);
+                tagger.parse(lattice);
+                lattice.clear();
+            }
+        }
+    }
+}
+
+/// RAII guard of a [`Lattice`] taken from a [`LatticePool`].
+///
+/// It dereferences to the lattice, and returns it to the pool when dropped.
+pub struct PooledLattice<'p, 'm> {
+    pool: &'p LatticePool<'m>,
+    home: usize,
+    lattice: Option<Lattice<'m>>,
+}
+
+impl<'m> Deref for PooledLattice<'_, 'm> {
+    type Target = Lattice<'m>;
+
+    #[inline]
+    fn deref(&self) -> &Self::Target {
+        self.lattice.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledLattice<'_, '_> {
+    #[inline]
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.lattice.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledLattice<'_, '_> {
+    fn drop(&mut self) {
+        if let Some(mut lattice) = self.lattice.take() {
+            lattice.clear();
+            if let Ok(mut shard) = self.pool.shards[self.home].lock() {
+                shard.push(lattice);
+            }
+        }
+    }
+}
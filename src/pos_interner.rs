@@ -0,0 +1,228 @@
+use crate::feature_cache::PtrHasher;
+use crate::ffi::{Model, Node, Token};
+use crate::FeatureFields;
+
+use std::collections::HashMap;
+use std::hash::BuildHasherDefault;
+use std::str::Utf8Error;
+use std::sync::RwLock;
+
+/// The number of fields interned by [`Model::pos_interner()`]: the part-of-speech and its three
+/// subcategories in IPADIC and UniDic.
+pub const DEFAULT_POS_FIELDS: usize = 4;
+
+/// Small integer id of a part-of-speech, assigned by a [`PosInterner`] in the order of first
+/// appearance.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash)]
+pub struct PosId(u32);
+
+impl PosId {
+    #[inline]
+    pub fn index(self) -> usize {
+        self.0 as _
+    }
+}
+
+/// Upper bound of the feature pointers remembered by a [`PosInterner`].
+const MAX_PTR_ENTRIES: usize = 1 << 20;
+
+#[derive(Debug, Clone, Copy)]
+enum PtrEntry {
+    /// Features of length `len` with the prefix `id`.
+    Known { len: usize, id: PosId },
+    /// The pointer has been seen with other contents.
+    Volatile,
+}
+
+#[derive(Debug, Default)]
+struct Inner {
+    ids: HashMap<Box<[u8]>, PosId>,
+    by_ptr: HashMap<usize, PtrEntry, BuildHasherDefault<PtrHasher>>,
+    names: Vec<Box<[u8]>>,
+}
+
+impl Inner {
+    /// Returns true if `features`, of the same length as the features `id` was cached for,
+    /// still begins with the prefix `id`.
+    fn still_matches(&self, id: PosId, features: &[u8]) -> bool {
+        let name = &self.names[id.index()];
+        // A prefix shorter than the features ends at a field separator; one as long is the
+        // whole string.
+        features.starts_with(name) && (features.len() == name.len() || features[name.len()] == b',')
+    }
+}
+
+/// Thread-safe table assigning a [`PosId`] to each distinct prefix of the first `fields` feature
+/// fields, e.g. `名詞,固有名詞,地域,一般`.
+///
+/// Grouping or filtering tokens by part-of-speech otherwise compares and hashes strings for
+/// every token. With an interner, the prefix is split and looked up once per distinct string,
+/// and the hot path compares integers. As with [`FeatureCache`](crate::FeatureCache), known words
+/// are also looked up by the address of their features in the dictionary, so a repeated entry
+/// is not split again. The features found at a known address are checked against the interned
+/// prefix, as known words may have features allocated by the lattice at reused addresses; such
+/// an address is not looked up any more.
+///
+/// Ids are added on first use and never removed, and [`PosInterner::name()`] returns the
+/// interned prefix borrowed from the interner. An interner should only see the nodes of one
+/// model, and must not outlive it: [`Model::pos_interner()`] returns an interner shared by the
+/// users of the model, which is reset when the model is swapped.
+///
+/// ```no_run
+/// # use mecab_wrapper::{Lattice, Model};
+/// # fn test(model: &Model, lattice: &Lattice<'_>) {
+/// let pos = model.pos_interner();
+/// let person = pos.intern("名詞,固有名詞,人名,一般".as_bytes());
+///
+/// for node in lattice.iter_nodes() {
+///     if node.pos_id_interned(pos) == person {
+///         println!("{}", node.surface_str().unwrap());
+///     }
+/// }
+/// # }
+/// ```
+#[derive(Debug)]
+pub struct PosInterner {
+    fields: usize,
+    inner: RwLock<Inner>,
+}
+
+impl PosInterner {
+    /// An interner of the first `fields` feature fields.
+    pub fn new(fields: usize) -> Self {
+        Self {
+            fields,
+            inner: RwLock::default(),
+        }
+    }
+
+    /// The number of fields of each prefix.
+    #[inline]
+    pub fn fields(&self) -> usize {
+        self.fields
+    }
+
+    /// The number of interned prefixes.
+    pub fn len(&self) -> usize {
+        self.inner.read().unwrap().names.len()
+    }
+
+    /// Returns true if nothing is interned.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// The first [`PosInterner::fields()`] fields of `features`, joined by commas as in the
+    /// input.
+    pub fn prefix<'f>(&self, features: &'f [u8]) -> &'f [u8] {
+        let mut fields = FeatureFields::new(features);
+        for _ in 0..self.fields {
+            if fields.next().is_none() {
+                return features;
+            }
+        }
+        let rest = fields.remainder();
+        if rest.is_empty() {
+            features.strip_suffix(b",").unwrap_or(features)
+        } else {
+            &features[..features.len() - rest.len() - 1]
+        }
+    }
+
+    /// Returns the id of the prefix of `features`, assigning a new one on first use.
+    pub fn intern(&self, features: &[u8]) -> PosId {
+        let prefix = self.prefix(features);
+        if let Some(&id) = self.inner.read().unwrap().ids.get(prefix) {
+            return id;
+        }
+        let mut inner = self.inner.write().unwrap();
+        if let Some(&id) = inner.ids.get(prefix) {
+            return id;
+        }
+        let id = PosId(inner.names.len() as u32);
+        inner.names.push(prefix.into());
+        inner.ids.insert(prefix.into(), id);
+        id
+    }
+
+    /// Returns the id of the prefix of `features` if it is interned.
+    pub fn get(&self, features: &[u8]) -> Option<PosId> {
+        let prefix = self.prefix(features);
+        self.inner.read().unwrap().ids.get(prefix).copied()
+    }
+
+    /// The prefix interned as `id`. It returns `None` if `id` is not from `self`.
+    pub fn name(&self, id: PosId) -> Option<&[u8]> {
+        let inner = self.inner.read().unwrap();
+        let name: *const [u8] = &**inner.names.get(id.index())?;
+        // The boxes are never dropped or mutated while `self` is alive; only the `Vec` holding
+        // them can reallocate, which does not move their contents.
+        Some(unsafe { &*name })
+    }
+
+    /// Converts [`PosInterner::name()`] as a [`&str`].
+    pub fn name_str(&self, id: PosId) -> Option<Result<&str, Utf8Error>> {
+        self.name(id).map(std::str::from_utf8)
+    }
+
+    fn intern_node(&self, node: &Node) -> PosId {
+        let features = node.features();
+        if !node.status().is_normal() {
+            return self.intern(features);
+        }
+        let ptr = features.as_ptr() as usize;
+        let cached = {
+            let inner = self.inner.read().unwrap();
+            match inner.by_ptr.get(&ptr).copied() {
+                Some(PtrEntry::Known { len, id })
+                    if len == features.len() && inner.still_matches(id, features) =>
+                {
+                    return id;
+                }
+                Some(PtrEntry::Volatile) => {
+                    drop(inner);
+                    return self.intern(features);
+                }
+                cached => cached,
+            }
+        };
+
+        let id = self.intern(features);
+        let mut inner = self.inner.write().unwrap();
+        if cached.is_some() {
+            // Features allocated by the lattice, at an address reused by a later parse.
+            inner.by_ptr.insert(ptr, PtrEntry::Volatile);
+        } else if inner.by_ptr.len() < MAX_PTR_ENTRIES {
+            let len = features.len();
+            inner.by_ptr.insert(ptr, PtrEntry::Known { len, id });
+        }
+        id
+    }
+}
+
+impl Node {
+    /// The id of the first [`PosInterner::fields()`] feature fields in `interner`. See
+    /// [`PosInterner`].
+    #[inline]
+    pub fn pos_id_interned(&self, interner: &PosInterner) -> PosId {
+        interner.intern_node(self)
+    }
+}
+
+impl<'a> Token<'a> {
+    /// Same as [`Node::pos_id_interned()`].
+    #[inline]
+    pub fn pos_id_interned(self, interner: &PosInterner) -> PosId {
+        interner.intern(self.features())
+    }
+}
+
+impl Model {
+    /// A [`PosInterner`] of [`DEFAULT_POS_FIELDS`] fields, created on first use and shared by
+    /// all the users of `self`. It is reset by [`Model::swap()`], as the old ids may not match the
+    /// new dictionary.
+    pub fn pos_interner(&self) -> &PosInterner {
+        self.pos_interner
+            .get_or_init(|| PosInterner::new(DEFAULT_POS_FIELDS))
+    }
+}
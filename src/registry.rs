@@ -0,0 +1,292 @@
+use crate::ffi::Model;
+
+use std::collections::{HashMap, HashSet};
+use std::fs::File;
+use std::io::{self, BufRead, BufReader};
+use std::ops::Range;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, RwLock};
+
+/// Resident memory of the files mapped by a model, from `/proc/self/smaps`.
+#[derive(Debug, Clone, Default, PartialEq, Eq, Hash)]
+pub struct ResidentMemory {
+    /// Bytes of the files in physical memory, counting the pages shared with other processes
+    /// in full.
+    pub rss: u64,
+    /// Proportional set size: each shared page is divided by the number of processes mapping
+    /// it. Summing this over the processes of a host gives their actual total.
+    pub pss: u64,
+    /// Part of [`ResidentMemory::rss`] mapped more than once, by other processes or by several
+    /// models of this process.
+    pub shared: u64,
+    /// The canonical paths of the mapped files with their RSS and PSS, in the order of
+    /// [`Model::dictionary_files()`].
+    pub files: Vec<(PathBuf, u64, u64)>,
+}
+
+#[derive(Debug, Default, Clone, Copy)]
+struct Usage {
+    rss: u64,
+    pss: u64,
+    shared: u64,
+}
+
+/// The file offset and path of a mapping header `start-end perms offset dev inode [path]`. The
+/// path may contain spaces.
+fn mapping_header(header: &str) -> Option<(u64, &str)> {
+    let mut rest = header;
+    let mut offset = None;
+    for i in 0..5 {
+        rest = rest.trim_start();
+        let end = rest.find(' ')?;
+        if i == 2 {
+            offset = u64::from_str_radix(&rest[..end], 16).ok();
+        }
+        rest = &rest[end..];
+    }
+    let path = rest.trim();
+    (!path.is_empty()).then_some((offset?, path))
+}
+
+/// The dictionary files of `model`, canonicalized to match the paths in `/proc/self/smaps`.
+fn mapped_files(model: &Model) -> Vec<PathBuf> {
+    let files = model.dictionary_files().into_iter();
+    files
+        .map(|f| std::fs::canonicalize(&f.path).unwrap_or(f.path))
+        .collect()
+}
+
+/// The address ranges where the dictionary files of `model` are mapped, from `/proc/self/maps`,
+/// sorted. A file mapped by several models has one range per model.
+pub(crate) fn mapped_ranges(model: &Model) -> io::Result<Vec<Range<usize>>> {
+    let files = mapped_files(model);
+    let paths: HashSet<&Path> = files.iter().map(PathBuf::as_path).collect();
+    let reader = BufReader::new(File::open("/proc/self/maps")?);
+
+    let mut ranges = Vec::new();
+    for line in reader.lines() {
+        let line = line?;
+        if !mapping_header(&line).map_or(false, |(_, p)| paths.contains(Path::new(p))) {
+            continue;
+        }
+        let range = line.split(' ').next().and_then(|r| r.split_once('-'));
+        let range = range.and_then(|(start, end)| {
+            let start = usize::from_str_radix(start, 16).ok()?;
+            let end = usize::from_str_radix(end, 16).ok()?;
+            Some(start..end)
+        });
+        ranges.extend(range);
+    }
+    ranges.sort_unstable_by_key(|r| r.start);
+    Ok(ranges)
+}
+
+/// Reads the memory usage of the files `paths` from `/proc/self/smaps`.
+///
+/// Each model maps its files on its own, so a file loaded by several models of this process has
+/// one mapping per model, all backed by the same pages of the page cache. Summing their RSS would
+/// count these pages once per model. Instead the RSS of each part of a file, keyed by its offset,
+/// is that of its largest mapping, and the parts are summed, in case the kernel split a mapping.
+/// The PSS of a mapping is already divided by the number of mappings of each page, so it is
+/// summed over all of them.
+fn read_smaps(paths: &HashSet<&Path>) -> io::Result<HashMap<PathBuf, Usage>> {
+    let mut parts: HashMap<(PathBuf, u64), Usage> = HashMap::new();
+    let reader = BufReader::new(File::open("/proc/self/smaps")?);
+    let mut current: Option<(PathBuf, u64)> = None;
+    let mut mapping = Usage::default();
+    let mut flush = |current: &Option<(PathBuf, u64)>, mapping: &mut Usage| {
+        if let Some(key) = current {
+            let part = parts.entry(key.clone()).or_default();
+            part.rss = part.rss.max(mapping.rss);
+            part.pss += mapping.pss;
+            part.shared = part.shared.max(mapping.shared);
+        }
+        *mapping = Usage::default();
+    };
+
+    for line in reader.lines() {
+        let line = line?;
+        let mut words = line.split_ascii_whitespace();
+        let Some(first) = words.next() else {
+            continue;
+        };
+
+        if !first.ends_with(':') {
+            flush(&current, &mut mapping);
+            current = mapping_header(&line)
+                .filter(|(_, p)| paths.contains(Path::new(p)))
+                .map(|(offset, p)| (PathBuf::from(p), offset));
+            continue;
+        }
+        if current.is_none() {
+            continue;
+        }
+        let kb: u64 = match words.next().and_then(|n| n.parse().ok()) {
+            Some(kb) => kb,
+            None => continue,
+        };
+        match first {
+            "Rss:" => mapping.rss += kb << 10,
+            "Pss:" => mapping.pss += kb << 10,
+            "Shared_Clean:" | "Shared_Dirty:" => mapping.shared += kb << 10,
+            _ => {}
+        }
+    }
+    flush(&current, &mut mapping);
+
+    let mut usage: HashMap<PathBuf, Usage> = HashMap::new();
+    for ((path, _), part) in parts {
+        let u = usage.entry(path).or_default();
+        u.rss += part.rss;
+        u.pss += part.pss;
+        u.shared += part.shared;
+    }
+    Ok(usage)
+}
+
+impl Model {
+    /// Resident memory of the dictionary files of `self` (see [`Model::dictionary_files()`]).
+    ///
+    /// MeCab maps the dictionaries read-only and shared, so the pages are in the page cache once
+    /// however many models and processes load them. A file mapped by several models of this
+    /// process is counted once, and another model mapping the same files reports the same
+    /// pages.
+    pub fn resident_memory(&self) -> io::Result<ResidentMemory> {
+        let files = mapped_files(self);
+        let paths = files.iter().map(PathBuf::as_path).collect();
+        let usage = read_smaps(&paths)?;
+        Ok(collect_usage(files, &usage))
+    }
+}
+
+fn collect_usage(files: Vec<PathBuf>, usage: &HashMap<PathBuf, Usage>) -> ResidentMemory {
+    let mut memory = ResidentMemory::default();
+    for path in files {
+        let u = usage.get(&path).copied().unwrap_or_default();
+        memory.rss += u.rss;
+        memory.pss += u.pss;
+        memory.shared += u.shared;
+        memory.files.push((path, u.rss, u.pss));
+    }
+    memory
+}
+
+struct Entry {
+    args: String,
+    model: Arc<Model>,
+}
+
+/// Named models, loaded once per distinct set of arguments.
+///
+/// A service that routes requests to several models, e.g. one per user dictionary, loads each of
+/// them by name with [`ModelRegistry::load()`]. Names loaded with the same arguments share one
+/// [`Model`]. Models with different arguments still share the pages of the files they have in
+/// common, such as the system dictionary, as MeCab maps the dictionaries read-only and
+/// shared; [`ModelRegistry::memory()`] reports the resident memory of each model.
+///
+/// ```no_run
+/// use mecab_wrapper::ModelRegistry;
+///
+/// let registry = ModelRegistry::new();
+/// registry.load("default", "").unwrap();
+/// registry.load("medical", "-u /var/lib/app/medical.dic").unwrap();
+///
+/// let model = registry.get("medical").unwrap();
+/// let tagger = model.create_tagger().unwrap();
+///
+/// for (name, memory) in registry.memory().unwrap() {
+///     println!("{name}: rss {} pss {}", memory.rss, memory.pss);
+/// }
+/// ```
+#[derive(Default)]
+pub struct ModelRegistry {
+    models: RwLock<HashMap<String, Entry>>,
+}
+
+impl ModelRegistry {
+    #[inline]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Returns the model of `name`, loading it from `args` (see [`Model::new()`]) unless a model
+    /// with the same arguments is already registered.
+    ///
+    /// If `name` is registered with other arguments, it is replaced; the old model is freed when
+    /// its last user drops it. Returns `None` if the model cannot be created, keeping any current
+    /// model of `name`.
+    pub fn load(&self, name: &str, args: &str) -> Option<Arc<Model>> {
+        let args = args.trim();
+        let shared = {
+            let models = self.models.read().unwrap();
+            if let Some(entry) = models.get(name).filter(|e| e.args == args) {
+                return Some(Arc::clone(&entry.model));
+            }
+            models
+                .values()
+                .find(|e| e.args == args)
+                .map(|e| Arc::clone(&e.model))
+        };
+
+        // Load without holding the lock.
+        let model = match shared {
+            Some(model) => model,
+            None => Arc::new(Model::new(args)?),
+        };
+        let entry = Entry {
+            args: args.to_string(),
+            model: Arc::clone(&model),
+        };
+        self.models.write().unwrap().insert(name.to_string(), entry);
+        Some(model)
+    }
+
+    /// Returns the model of `name`.
+    pub fn get(&self, name: &str) -> Option<Arc<Model>> {
+        let models = self.models.read().unwrap();
+        models.get(name).map(|e| Arc::clone(&e.model))
+    }
+
+    /// Unregisters `name` and returns its model.
+    pub fn remove(&self, name: &str) -> Option<Arc<Model>> {
+        self.models.write().unwrap().remove(name).map(|e| e.model)
+    }
+
+    /// The registered names, in no particular order.
+    pub fn names(&self) -> Vec<String> {
+        self.models.read().unwrap().keys().cloned().collect()
+    }
+
+    /// The number of registered names.
+    pub fn len(&self) -> usize {
+        self.models.read().unwrap().len()
+    }
+
+    /// Returns true if no names are registered.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Resident memory of each registered model, reading `/proc/self/smaps` once. Names sharing
+    /// a model report the same memory, and each model reports the files it shares with other
+    /// models in full, so the sum over the models counts the shared files more than once.
+    pub fn memory(&self) -> io::Result<Vec<(String, ResidentMemory)>> {
+        let files: Vec<(String, Vec<PathBuf>)> = self
+            .models
+            .read()
+            .unwrap()
+            .iter()
+            .map(|(name, e)| (name.clone(), mapped_files(&e.model)))
+            .collect();
+
+        let paths = files
+            .iter()
+            .flat_map(|(_, f)| f.iter().map(PathBuf::as_path))
+            .collect();
+        let usage = read_smaps(&paths)?;
+        Ok(files
+            .into_iter()
+            .map(|(name, files)| (name, collect_usage(files, &usage)))
+            .collect())
+    }
+}
@@ -0,0 +1,175 @@
+use crate::ffi::{Boundary, Lattice, Tagger, TokenBuffer};
+
+use std::ops::Range;
+
+/// The number of unchanged tokens [`Tagger::reparse()`] parses again on each side of an edit by
+/// default.
+pub const DEFAULT_CONTEXT_TOKENS: usize = 2;
+
+/// An edit of a parsed sentence, passed to [`Tagger::reparse()`]: the bytes `range` of the old
+/// text were replaced by `new_len` bytes.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct Edit {
+    /// Byte range of the replaced text in the old text.
+    pub range: Range<usize>,
+    /// Length in bytes of the text replacing `range`.
+    pub new_len: usize,
+    /// The number of unchanged tokens parsed again on each side of the edit.
+    pub context: usize,
+}
+
+impl Edit {
+    /// The replacement of `range` by `new_len` bytes. An insertion has an empty `range`, and a
+    /// deletion a `new_len` of `0`.
+    #[inline]
+    pub fn new(range: Range<usize>, new_len: usize) -> Self {
+        Self {
+            range,
+            new_len,
+            context: DEFAULT_CONTEXT_TOKENS,
+        }
+    }
+
+    /// Sets [`Edit::context`].
+    #[inline]
+    pub fn context(mut self, context: usize) -> Self {
+        self.context = context;
+        self
+    }
+
+    /// The number of bytes added to the offsets after the edit.
+    #[inline]
+    pub fn shift(&self) -> isize {
+        self.new_len as isize - self.range.len() as isize
+    }
+}
+
+/// The tokens and byte ranges of the window of [`Tagger::reparse()`].
+#[derive(Debug, Clone, PartialEq, Eq)]
+struct Window {
+    /// Old tokens replaced by the new tokens of the window.
+    tokens: Range<usize>,
+    /// Tokens before and after the edit, which keep their surfaces.
+    pinned: [Range<usize>; 2],
+    /// Byte range of the window in the new text. It begins at the same offset as in the old
+    /// text.
+    bytes: Range<usize>,
+}
+
+fn window(tokens: &TokenBuffer, old_len: usize, edit: &Edit) -> Window {
+    let begins = tokens.begins();
+    let lengths = tokens.lengths();
+    let end = |i: usize| begins[i] + lengths[i] as usize;
+
+    // A token touching the edit, e.g. a word the user is typing the end of, is parsed again.
+    let touched_begin = (0..tokens.len()).find(|&i| end(i) >= edit.range.start);
+    let touched_begin = touched_begin.unwrap_or(tokens.len());
+    let touched_end = (touched_begin..tokens.len())
+        .find(|&i| begins[i] > edit.range.end)
+        .unwrap_or(tokens.len());
+    let first = touched_begin.saturating_sub(edit.context);
+    let last = (touched_end + edit.context).min(tokens.len());
+
+    let old_begin = if first == 0 { 0 } else { end(first - 1) };
+    let old_end = if last == tokens.len() {
+        old_len
+    } else {
+        begins[last]
+    };
+    let new_end = (old_end as isize + edit.shift()) as usize;
+    Window {
+        tokens: first..last,
+        pinned: [first..touched_begin, touched_end..last],
+        bytes: old_begin..new_end,
+    }
+}
+
+impl<'a> Tagger<'a> {
+    /// Updates `tokens`, the tokens of a sentence before `edit`, to the tokens of the edited
+    /// sentence `text`, parsing only a window around the edit.
+    ///
+    /// The window spans the tokens touching the edit and [`Edit::context`] tokens on each side.
+    /// The context tokens keep their surfaces with [`Boundary`] constraints, but their features
+    /// are reparsed with the edited tokens as neighbours. The tokens of the window are then
+    /// spliced into `tokens`, and the begins of the following tokens are shifted by
+    /// [`Edit::shift()`], so the cost of a keystroke does not depend on the length of the
+    /// sentence, except for moving the following tokens.
+    ///
+    /// The result equals parsing the whole `text` as long as the edit does not change the best
+    /// path beyond the context tokens, which a larger context makes more likely. The
+    /// [`Token::cost()`](crate::Token::cost()) of the tokens of the window, an accumulated cost,
+    /// is counted from the start of the window.
+    ///
+    /// `tokens` must hold the one sentence of the old text, e.g. from
+    /// [`Lattice::export_tokens()`] or a former call, and is left with one sentence. `lattice`
+    /// is left with the window. If the window cannot be parsed, it returns false and `tokens` is
+    /// unchanged.
+    ///
+    /// # Panics
+    /// Panics if `edit` is out of the old text or does not match the length of `text`.
+    ///
+    /// ```no_run
+    /// use mecab_wrapper::{Edit, Lattice, Tagger, TokenBuffer};
+    ///
+    /// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>) {
+    /// let mut text = String::from("今日は晴れです。");
+    /// let mut tokens = TokenBuffer::new();
+    /// lattice.set_sentence(&text);
+    /// tagger.parse(lattice);
+    /// lattice.export_tokens(&mut tokens);
+    ///
+    /// // The user replaces "晴れ" with "雨".
+    /// text.replace_range(9..15, "雨");
+    /// if tagger.reparse(lattice, &text, &mut tokens, &Edit::new(9..15, 3)) {
+    ///     for token in tokens.tokens() {
+    ///         println!("{}", &text[token.surface_range()]);
+    ///     }
+    /// }
+    /// # }
+    /// ```
+    pub fn reparse<T: AsRef<[u8]> + ?Sized>(
+        &self,
+        lattice: &mut Lattice,
+        text: &T,
+        tokens: &mut TokenBuffer,
+        edit: &Edit,
+    ) -> bool {
+        let text = text.as_ref();
+        let old_len = (text.len() + edit.range.len())
+            .checked_sub(edit.new_len)
+            .expect("the edit is longer than the text");
+        assert!(
+            edit.range.start <= edit.range.end && edit.range.end <= old_len,
+            "edit {:?} out of the old text of length {old_len}",
+            edit.range,
+        );
+
+        let window = window(tokens, old_len, edit);
+        lattice.set_sentence_bytes(&text[window.bytes.clone()]);
+        for (k, pinned) in window.pinned.iter().enumerate() {
+            // Tokens after the edit have moved by the shift in the new text.
+            let base = if k == 0 {
+                window.bytes.start as isize
+            } else {
+                window.bytes.start as isize - edit.shift()
+            };
+            for i in pinned.clone() {
+                let begin = (tokens.begins()[i] as isize - base) as usize;
+                let end = begin + tokens.lengths()[i] as usize;
+                lattice.set_boundary_constraint(begin, Boundary::Token);
+                for pos in begin + 1..end {
+                    lattice.set_boundary_constraint(pos, Boundary::InsideToken);
+                }
+                lattice.set_boundary_constraint(end, Boundary::Token);
+            }
+        }
+        if !self.parse(lattice) {
+            return false;
+        }
+
+        let mut reparsed = TokenBuffer::new();
+        lattice.export_tokens(&mut reparsed);
+        tokens.splice(window.tokens, &reparsed, window.bytes.start, edit.shift());
+        true
+    }
+}
@@ -0,0 +1,384 @@
+use crate::ffi::{Boundary, Lattice, RequestType, Tagger, TokenBuffer};
+
+use std::collections::hash_map::RandomState;
+use std::collections::HashMap;
+use std::hash::{BuildHasher, BuildHasherDefault, Hash, Hasher};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+
+/// Options of [`SentenceCache::new()`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct CacheOptions {
+    /// The number of independently locked shards.
+    pub shards: usize,
+    /// Upper bound of the memory used by the cached entries, in bytes, split evenly across the
+    /// shards.
+    pub max_bytes: usize,
+}
+
+impl Default for CacheOptions {
+    fn default() -> Self {
+        Self::new(64 << 20)
+    }
+}
+
+impl CacheOptions {
+    /// Options for a cache of `max_bytes`, with 4 shards per available thread.
+    pub fn new(max_bytes: usize) -> Self {
+        let threads = std::thread::available_parallelism().map_or(1, |n| n.get());
+        Self {
+            shards: threads * 4,
+            max_bytes,
+        }
+    }
+
+    /// Sets [`CacheOptions::shards`].
+    #[inline]
+    pub fn shards(mut self, shards: usize) -> Self {
+        self.shards = shards.max(1);
+        self
+    }
+}
+
+/// Counters of a [`SentenceCache`], returned by [`SentenceCache::stats()`].
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct CacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    /// The number of entries evicted to stay within [`CacheOptions::max_bytes`].
+    pub evictions: u64,
+    /// The number of cached entries.
+    pub entries: usize,
+    /// Memory used by the cached entries, in bytes.
+    pub bytes: usize,
+}
+
+impl CacheStats {
+    /// `hits / (hits + misses)`, or `0.0` if nothing is looked up.
+    pub fn hit_ratio(&self) -> f64 {
+        let total = self.hits + self.misses;
+        if total == 0 {
+            0.0
+        } else {
+            self.hits as f64 / total as f64
+        }
+    }
+}
+
+/// Everything that determines the result of parsing, except the model itself.
+#[derive(Debug, PartialEq, Eq, Hash)]
+struct Key {
+    sentence: Box<[u8]>,
+    request_type: RequestType,
+    constraints: u64,
+    generation: u64,
+}
+
+const NIL: usize = usize::MAX;
+
+#[derive(Debug)]
+struct Entry {
+    hash: u64,
+    key: Key,
+    tokens: Arc<TokenBuffer>,
+    bytes: usize,
+    /// Towards the most recently used entry.
+    prev: usize,
+    /// Towards the least recently used entry.
+    next: usize,
+}
+
+/// LRU list over a slab of entries, indexed by the key hash.
+#[derive(Debug, Default)]
+struct Shard {
+    index: HashMap<u64, usize, BuildHasherDefault<HashHasher>>,
+    entries: Vec<Option<Entry>>,
+    free: Vec<usize>,
+    head: usize,
+    tail: usize,
+    bytes: usize,
+}
+
+impl Shard {
+    fn new() -> Self {
+        Self {
+            head: NIL,
+            tail: NIL,
+            ..Self::default()
+        }
+    }
+
+    fn entry(&mut self, i: usize) -> &mut Entry {
+        self.entries[i].as_mut().unwrap()
+    }
+
+    fn unlink(&mut self, i: usize) {
+        let (prev, next) = {
+            let e = self.entry(i);
+            (e.prev, e.next)
+        };
+        match prev {
+            NIL => self.head = next,
+            p => self.entry(p).next = next,
+        }
+        match next {
+            NIL => self.tail = prev,
+            n => self.entry(n).prev = prev,
+        }
+    }
+
+    fn push_front(&mut self, i: usize) {
+        let head = self.head;
+        {
+            let e = self.entry(i);
+            e.prev = NIL;
+            e.next = head;
+        }
+        match head {
+            NIL => self.tail = i,
+            h => self.entry(h).prev = i,
+        }
+        self.head = i;
+    }
+
+    fn get(&mut self, hash: u64, key: &Key) -> Option<Arc<TokenBuffer>> {
+        let i = *self.index.get(&hash)?;
+        if self.entries[i].as_ref().unwrap().key != *key {
+            return None;
+        }
+        if self.head != i {
+            self.unlink(i);
+            self.push_front(i);
+        }
+        Some(Arc::clone(&self.entries[i].as_ref().unwrap().tokens))
+    }
+
+    fn remove(&mut self, i: usize) {
+        self.unlink(i);
+        let e = self.entries[i].take().unwrap();
+        self.index.remove(&e.hash);
+        self.bytes -= e.bytes;
+        self.free.push(i);
+    }
+
+    /// Inserts the entry and returns the number of entries evicted.
+    fn insert(&mut self, entry: Entry, max_bytes: usize) -> u64 {
+        if entry.bytes > max_bytes {
+            // It would not fit even in an empty shard, so it is not worth evicting anything.
+            return 0;
+        }
+        if let Some(&i) = self.index.get(&entry.hash) {
+            // The same key inserted by another thread, or a hash collision.
+            self.remove(i);
+        }
+
+        let mut evicted = 0;
+        while self.tail != NIL && self.bytes + entry.bytes > max_bytes {
+            self.remove(self.tail);
+            evicted += 1;
+        }
+
+        let (hash, bytes) = (entry.hash, entry.bytes);
+        let i = match self.free.pop() {
+            Some(i) => {
+                self.entries[i] = Some(entry);
+                i
+            }
+            None => {
+                self.entries.push(Some(entry));
+                self.entries.len() - 1
+            }
+        };
+        self.index.insert(hash, i);
+        self.bytes += bytes;
+        self.push_front(i);
+        evicted
+    }
+
+    fn clear(&mut self) {
+        *self = Self::new();
+    }
+}
+
+/// Hasher for keys which are hashes already.
+#[derive(Debug, Default)]
+struct HashHasher(u64);
+
+impl Hasher for HashHasher {
+    #[inline]
+    fn finish(&self) -> u64 {
+        self.0
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.0 = (self.0 << 8) | b as u64;
+        }
+    }
+
+    #[inline]
+    fn write_u64(&mut self, n: u64) {
+        self.0 = n;
+    }
+}
+
+/// Concurrent LRU cache of parse results, keyed by the sentence, the request type, the
+/// constraints and the model generation.
+///
+/// [`SentenceCache::parse()`] looks up the sentence set on the lattice before parsing it, and
+/// returns the cached tokens of an identical earlier request without calling MeCab. On a miss, it
+/// parses the lattice and caches the result of
+/// [`Lattice::export_tokens()`](crate::Lattice::export_tokens()). Results are shared as
+/// `Arc<TokenBuffer>`, so a hit copies nothing.
+///
+/// The cache is split into shards, each with its own lock and LRU list, and the least recently
+/// used entries are evicted to stay within [`CacheOptions::max_bytes`]. A result larger than a
+/// shard is returned but not cached. Pass the
+/// [generation](crate::ModelSnapshot::generation()) of the model to `parse()`, so that results of
+/// the previous model are never returned after a reload; they are evicted as they fall out of
+/// use.
+///
+/// ```no_run
+/// use mecab_wrapper::{CacheOptions, SentenceCache, SharedModel};
+///
+/// # fn test(shared: &SharedModel, cache: &SentenceCache) {
+/// let model = shared.load();
+/// let tagger = model.create_tagger().unwrap();
+/// let mut lattice = model.create_lattice();
+///
+/// let text = "すもももももももものうち";
+/// lattice.set_sentence(text);
+/// if let Some(tokens) = cache.parse(&tagger, &mut lattice, model.generation()) {
+///     for token in tokens.tokens() {
+///         println!("{}", &text[token.surface_range()]);
+///     }
+/// }
+/// println!("hit ratio: {}", cache.stats().hit_ratio());
+/// # }
+/// ```
+#[derive(Debug)]
+pub struct SentenceCache {
+    shards: Box<[Mutex<Shard>]>,
+    max_shard_bytes: usize,
+    hasher: RandomState,
+    hits: AtomicU64,
+    misses: AtomicU64,
+    evictions: AtomicU64,
+}
+
+impl Default for SentenceCache {
+    fn default() -> Self {
+        Self::new(CacheOptions::default())
+    }
+}
+
+impl SentenceCache {
+    pub fn new(options: CacheOptions) -> Self {
+        let shards = options.shards.max(1);
+        Self {
+            shards: (0..shards).map(|_| Mutex::new(Shard::new())).collect(),
+            max_shard_bytes: options.max_bytes / shards,
+            hasher: RandomState::new(),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+            evictions: AtomicU64::new(0),
+        }
+    }
+
+    /// Returns the tokens of the sentence set on `lattice`, from the cache or by parsing it with
+    /// `tagger`. `generation` identifies the model of `tagger` and `lattice`.
+    ///
+    /// The key is taken from the lattice: the request type, and the boundary and feature
+    /// constraints if any are set. Returns `None` if parsing fails; failures are not cached.
+    ///
+    /// On a hit, the lattice is not parsed, so do not read its nodes afterwards.
+    pub fn parse(
+        &self,
+        tagger: &Tagger<'_>,
+        lattice: &mut Lattice<'_>,
+        generation: u64,
+    ) -> Option<Arc<TokenBuffer>> {
+        let key = Key {
+            sentence: lattice.sentence().into(),
+            request_type: lattice.get_request_type(),
+            constraints: constraints_fingerprint(lattice),
+            generation,
+        };
+        let hash = {
+            let mut h = self.hasher.build_hasher();
+            key.hash(&mut h);
+            h.finish()
+        };
+        let shard = &self.shards[(hash % self.shards.len() as u64) as usize];
+
+        if let Some(tokens) = shard.lock().unwrap().get(hash, &key) {
+            self.hits.fetch_add(1, Ordering::Relaxed);
+            return Some(tokens);
+        }
+        self.misses.fetch_add(1, Ordering::Relaxed);
+
+        if !tagger.parse(lattice) {
+            return None;
+        }
+        let mut tokens = TokenBuffer::new();
+        lattice.export_tokens(&mut tokens);
+        tokens.shrink_to_fit();
+        let tokens = Arc::new(tokens);
+
+        let entry = Entry {
+            hash,
+            bytes: key.sentence.len() + tokens.heap_size() + std::mem::size_of::<Entry>(),
+            key,
+            tokens: Arc::clone(&tokens),
+            prev: NIL,
+            next: NIL,
+        };
+        let evicted = shard.lock().unwrap().insert(entry, self.max_shard_bytes);
+        if evicted > 0 {
+            self.evictions.fetch_add(evicted, Ordering::Relaxed);
+        }
+        Some(tokens)
+    }
+
+    /// Removes all the entries. The counters are kept.
+    pub fn clear(&self) {
+        for shard in self.shards.iter() {
+            shard.lock().unwrap().clear();
+        }
+    }
+
+    pub fn stats(&self) -> CacheStats {
+        let (mut entries, mut bytes) = (0, 0);
+        for shard in self.shards.iter() {
+            let shard = shard.lock().unwrap();
+            entries += shard.index.len();
+            bytes += shard.bytes;
+        }
+        CacheStats {
+            hits: self.hits.load(Ordering::Relaxed),
+            misses: self.misses.load(Ordering::Relaxed),
+            evictions: self.evictions.load(Ordering::Relaxed),
+            entries,
+            bytes,
+        }
+    }
+}
+
+/// Hash of the boundary and feature constraints of `lattice`, or `0` if it has none.
+fn constraints_fingerprint(lattice: &Lattice<'_>) -> u64 {
+    if !lattice.has_constraint() {
+        return 0;
+    }
+    // A fixed hasher, as the fingerprint is compared across calls.
+    let mut h = std::collections::hash_map::DefaultHasher::new();
+    for pos in 0..=lattice.sentence_len() {
+        let boundary = match lattice.boundary_constraint(pos) {
+            Boundary::NotSpecified => 0u8,
+            Boundary::Token => 1,
+            Boundary::InsideToken => 2,
+        };
+        boundary.hash(&mut h);
+        lattice.feature_constraint(pos).hash(&mut h);
+    }
+    h.finish() | 1
+}
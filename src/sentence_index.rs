@@ -0,0 +1,133 @@
+use crate::ffi::{Lattice, Node};
+
+use std::cell::OnceCell;
+use std::ops::Range;
+use std::str::Utf8Error;
+
+/// The sentence of a parsed lattice, validated as UTF-8 once, with an O(1) map from byte offsets
+/// to character offsets. It is returned by [`Lattice::sentence_index()`].
+///
+/// Every surface in the lattice is a slice of the sentence, so once the sentence is known to be
+/// UTF-8, [`SentenceIndex::surface()`] returns a node's surface as a `&str` with only two bounds
+/// and boundary checks, instead of the per-node scan of [`Node::surface_str()`]. The validation
+/// uses [`std::str::from_utf8()`], which checks a word of ASCII at a time.
+///
+/// The byte-to-character table, one `u32` per byte, is built on the first call that needs it.
+///
+/// ```no_run
+/// # use mecab_wrapper::Lattice;
+/// # fn test(lattice: &Lattice<'_>) {
+/// let index = lattice.sentence_index().unwrap();
+/// for node in lattice.iter_nodes() {
+///     let surface = index.surface(node).unwrap();
+///     let chars = index.char_range(node).unwrap();
+///     println!("{surface} at characters {chars:?}");
+/// }
+/// # }
+/// ```
+#[derive(Debug)]
+pub struct SentenceIndex<'a> {
+    sentence: &'a str,
+    chars: OnceCell<Box<[u32]>>,
+}
+
+impl<'a> SentenceIndex<'a> {
+    /// Validates `sentence`.
+    pub fn new(sentence: &'a [u8]) -> Result<Self, Utf8Error> {
+        Ok(Self::from_validated(std::str::from_utf8(sentence)?))
+    }
+
+    /// Indexes an already validated sentence.
+    #[inline]
+    pub fn from_validated(sentence: &'a str) -> Self {
+        Self {
+            sentence,
+            chars: OnceCell::new(),
+        }
+    }
+
+    /// The whole sentence.
+    #[inline]
+    pub fn as_str(&self) -> &'a str {
+        self.sentence
+    }
+
+    /// Length of the sentence in bytes.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.sentence.len()
+    }
+
+    /// Returns true if the sentence is empty.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.sentence.is_empty()
+    }
+
+    /// Length of the sentence in characters.
+    pub fn char_len(&self) -> usize {
+        self.table()[self.sentence.len()] as _
+    }
+
+    fn table(&self) -> &[u32] {
+        self.chars.get_or_init(|| {
+            let bytes = self.sentence.as_bytes();
+            let mut table = Vec::with_capacity(bytes.len() + 1);
+            let mut chars = 0u32;
+            for &b in bytes {
+                // Continuation bytes map to the character they belong to.
+                if (b as i8) >= -0x40 {
+                    chars += 1;
+                }
+                table.push(chars - 1);
+            }
+            table.push(chars);
+            table.into_boxed_slice()
+        })
+    }
+
+    /// The character offset of byte offset `byte`. It returns `None` if `byte` is beyond the
+    /// sentence or not at a character boundary.
+    #[inline]
+    pub fn char_offset(&self, byte: usize) -> Option<usize> {
+        if !self.sentence.is_char_boundary(byte) {
+            return None;
+        }
+        Some(self.table()[byte] as _)
+    }
+
+    /// Converts a byte range of the sentence into a character range.
+    pub fn char_range_of(&self, bytes: Range<usize>) -> Option<Range<usize>> {
+        Some(self.char_offset(bytes.start)?..self.char_offset(bytes.end)?)
+    }
+
+    /// Byte range of the surface of `node` in the sentence. It returns `None` if `node` is not in
+    /// this sentence.
+    #[inline]
+    pub fn byte_range(&self, node: &Node) -> Option<Range<usize>> {
+        let base = self.sentence.as_ptr() as usize;
+        let begin = (node.surface().as_ptr() as usize).checked_sub(base)?;
+        let end = begin + node.surface_len();
+        (end <= self.sentence.len()).then_some(begin..end)
+    }
+
+    /// Character range of the surface of `node` in the sentence.
+    #[inline]
+    pub fn char_range(&self, node: &Node) -> Option<Range<usize>> {
+        self.char_range_of(self.byte_range(node)?)
+    }
+
+    /// The surface of `node` as a `&str`, without validating it again. It returns `None` if
+    /// `node` is not in this sentence or does not lie on character boundaries.
+    #[inline]
+    pub fn surface(&self, node: &Node) -> Option<&'a str> {
+        self.sentence.get(self.byte_range(node)?)
+    }
+}
+
+impl<'a> Lattice<'a> {
+    /// Validates the sentence once for all the nodes. See [`SentenceIndex`].
+    pub fn sentence_index(&self) -> Result<SentenceIndex<'_>, Utf8Error> {
+        SentenceIndex::new(self.sentence_ref())
+    }
+}
@@ -0,0 +1,200 @@
+use crate::ffi::{Model, ModelArgs};
+
+use std::cell::RefCell;
+use std::mem::ManuallyDrop;
+use std::ops::Deref;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::mpsc::{self, Sender};
+use std::sync::{Arc, OnceLock, RwLock, Weak};
+use std::thread::JoinHandle;
+
+/// A published model, shared by its snapshots.
+struct Published {
+    model: ManuallyDrop<Model>,
+    generation: u64,
+    /// Set by [`SharedModel::reload_in_background()`] once the model is replaced. The last
+    /// snapshot then hands the model over instead of freeing it.
+    retire: OnceLock<Sender<Model>>,
+}
+
+impl Drop for Published {
+    fn drop(&mut self) {
+        let model = unsafe { ManuallyDrop::take(&mut self.model) };
+        if let Some(retire) = self.retire.get() {
+            // If the retiring thread is gone, the model comes back in the error and is freed
+            // here.
+            let _ = retire.send(model);
+        }
+    }
+}
+
+static NEXT_ID: AtomicU64 = AtomicU64::new(0);
+
+thread_local! {
+    /// The last model loaded by this thread from each [`SharedModel`], by id, with its
+    /// generation.
+    static CACHED: RefCell<Vec<(u64, u64, Weak<Published>)>> = const { RefCell::new(Vec::new()) };
+}
+
+/// A [`Model`] that can be replaced while other threads are parsing with it.
+///
+/// [`Model::swap()`] requires `&mut Model`, so it cannot be used while taggers and lattices
+/// borrow the model. `SharedModel` instead holds the current model in an [`Arc`]. Each request
+/// takes a [`ModelSnapshot`] with [`SharedModel::load()`], which only clones the `Arc`, and
+/// creates its taggers and lattices from the snapshot. [`SharedModel::publish()`] replaces the
+/// current model atomically: new snapshots see the new model, while the requests in flight finish
+/// on the old one, which is freed when the last snapshot of it is dropped.
+///
+/// [`SharedModel::load()`] takes no lock: each thread keeps a weak reference to the model it
+/// loaded last, and takes the lock only after a publication.
+/// [`SharedModel::reload_in_background()`] loads the new dictionary on another thread without
+/// blocking any reader, publishes it, and frees the old model off the request threads, so that a
+/// request never pays for unmapping it.
+///
+/// ```no_run
+/// use mecab_wrapper::SharedModel;
+/// use std::sync::Arc;
+///
+/// # fn test(model: mecab_wrapper::Model) {
+/// let shared = Arc::new(SharedModel::new(model));
+///
+/// // On each request:
+/// let model = shared.load();
+/// let tagger = model.create_tagger().unwrap();
+/// let mut lattice = model.create_lattice();
+/// lattice.set_sentence("すもももももももものうち");
+/// tagger.parse(&mut lattice);
+///
+/// // When the user dictionary is updated:
+/// shared.reload_in_background("-u /path/to/user.dic");
+/// # }
+/// ```
+pub struct SharedModel {
+    id: u64,
+    /// The generation of `current`, read without the lock.
+    generation: AtomicU64,
+    current: RwLock<Arc<Published>>,
+}
+
+impl SharedModel {
+    /// Starts with `model` as generation `0`.
+    pub fn new(model: Model) -> Self {
+        let current = Published {
+            model: ManuallyDrop::new(model),
+            generation: 0,
+            retire: OnceLock::new(),
+        };
+        Self {
+            id: NEXT_ID.fetch_add(1, Ordering::Relaxed),
+            generation: AtomicU64::new(0),
+            current: RwLock::new(Arc::new(current)),
+        }
+    }
+
+    /// Returns the current model.
+    ///
+    /// Unless a model was published since the last call on this thread, this only upgrades a
+    /// [`Weak`] held by the thread, without taking any lock.
+    pub fn load(&self) -> ModelSnapshot {
+        let generation = self.generation.load(Ordering::Acquire);
+        let cached = CACHED.try_with(|cached| {
+            let cached = cached.borrow();
+            let (_, _, weak) = cached
+                .iter()
+                .find(|&&(id, g, _)| id == self.id && g == generation)?;
+            weak.upgrade()
+        });
+        match cached {
+            Ok(Some(published)) => ModelSnapshot { published },
+            _ => self.load_locked(),
+        }
+    }
+
+    fn load_locked(&self) -> ModelSnapshot {
+        let published = Arc::clone(&self.current.read().unwrap());
+        let _ = CACHED.try_with(|cached| {
+            let mut cached = cached.borrow_mut();
+            cached.retain(|(id, _, weak)| *id != self.id && weak.strong_count() > 0);
+            cached.push((self.id, published.generation, Arc::downgrade(&published)));
+        });
+        ModelSnapshot { published }
+    }
+
+    /// The generation of the current model, incremented by every publication.
+    #[inline]
+    pub fn generation(&self) -> u64 {
+        self.generation.load(Ordering::Acquire)
+    }
+
+    /// Makes `model` the current model and returns the previous one.
+    ///
+    /// Dropping the returned snapshot frees the previous model if no one else references it.
+    pub fn publish(&self, model: Model) -> ModelSnapshot {
+        let mut current = self.current.write().unwrap();
+        let next = Published {
+            model: ManuallyDrop::new(model),
+            generation: current.generation + 1,
+            retire: OnceLock::new(),
+        };
+        let old = std::mem::replace(&mut *current, Arc::new(next));
+        self.generation.store(old.generation + 1, Ordering::Release);
+        ModelSnapshot { published: old }
+    }
+
+    /// Loads a new model from `args` on the calling thread, without holding any lock, and
+    /// publishes it.
+    ///
+    /// Returns the new generation, or `None` if the model cannot be created (see
+    /// [`Model::new()`]). In that case the current model is kept.
+    pub fn reload<A: ModelArgs>(&self, args: A) -> Option<u64> {
+        let model = Model::new(args)?;
+        let old = self.publish(model);
+        Some(old.generation() + 1)
+    }
+
+    /// Same as [`SharedModel::reload()`], but on a new thread.
+    ///
+    /// The returned handle yields the result of [`SharedModel::reload()`] as soon as the new
+    /// model is published. The previous model is then freed on another thread, once its last
+    /// [`ModelSnapshot`] is dropped, rather than on the request thread dropping it.
+    pub fn reload_in_background<A>(self: &Arc<Self>, args: A) -> JoinHandle<Option<u64>>
+    where
+        A: ModelArgs + Send + 'static,
+    {
+        let shared = Arc::clone(self);
+        std::thread::spawn(move || {
+            let model = Model::new(args)?;
+            let old = shared.publish(model);
+            let generation = old.generation() + 1;
+
+            let (sender, retired) = mpsc::channel();
+            let _ = old.published.retire.set(sender);
+            std::thread::spawn(move || drop(retired.recv()));
+            Some(generation)
+        })
+    }
+}
+
+/// A reference to the model of some generation, returned by [`SharedModel::load()`].
+///
+/// It dereferences to [`Model`], and keeps the model alive until dropped.
+#[derive(Clone)]
+pub struct ModelSnapshot {
+    published: Arc<Published>,
+}
+
+impl ModelSnapshot {
+    #[inline]
+    pub fn generation(&self) -> u64 {
+        self.published.generation
+    }
+}
+
+impl Deref for ModelSnapshot {
+    type Target = Model;
+
+    #[inline]
+    fn deref(&self) -> &Model {
+        &self.published.model
+    }
+}
@@ -0,0 +1,129 @@
+use crate::ffi::{Lattice, Tagger};
+
+use std::io::{self, BufRead};
+
+/// Line-oriented tokenizer over a [`BufRead`].
+///
+/// Each call of [`TokenStream::next_sentence()`] reads one line (without the trailing `"\n"` or
+/// `"\r\n"`), parses it, and returns the lattice. A line that lies entirely in the reader's
+/// buffer is passed to MeCab as is, and only a line that straddles two fills of the buffer is
+/// copied. Hence the memory is bounded by the buffer size and the longest line, regardless of the
+/// input size.
+///
+/// `&[u8]` is a [`BufRead`] whose buffer is the whole slice, so a [`MmapFile`](crate::MmapFile)
+/// is tokenized without copying at all.
+///
+/// ```no_run
+/// use mecab_wrapper::{Lattice, MmapFile, Tagger, TokenStream};
+///
+/// # fn test<'m>(tagger: &Tagger<'m>, lattice: &mut Lattice<'m>) -> std::io::Result<()> {
+/// let file = MmapFile::open("access.log")?;
+/// let mut stream = TokenStream::new(tagger, lattice, &file[..]);
+///
+/// while let Some(lattice) = stream.next_sentence()? {
+///     for node in lattice.iter_nodes() {
+///         println!("{}", node.surface_str().unwrap());
+///     }
+/// }
+///
+/// // Any `BufRead` works.
+/// let stdin = std::io::stdin().lock();
+/// let mut stream = TokenStream::new(tagger, lattice, stdin);
+/// while let Some(lattice) = stream.next_sentence()? {
+///     println!("{}", lattice.to_str().unwrap());
+/// }
+/// # Ok(())
+/// # }
+/// ```
+///
+/// To tokenize a file on many cores, split the mapped file into lines and pass them to
+/// [`Model::parse_parallel()`](crate::Model::parse_parallel()):
+///
+/// ```no_run
+/// # use mecab_wrapper::{MmapFile, Model, ParallelOptions};
+/// # fn test(model: &Model) -> Result<(), Box<dyn std::error::Error>> {
+/// let file = MmapFile::open("access.log")?;
+/// let text = std::str::from_utf8(&file)?;
+/// model.parse_parallel(text.lines(), ParallelOptions::default(), |_, _, _| {});
+/// # Ok(())
+/// # }
+/// ```
+pub struct TokenStream<'a, 'm, R> {
+    tagger: &'a Tagger<'m>,
+    lattice: &'a mut Lattice<'m>,
+    reader: R,
+    /// Bytes of the reader's buffer to consume before reading the next line.
+    consume: usize,
+    /// A line straddling two fills of the buffer.
+    carry: Vec<u8>,
+    lines: usize,
+}
+
+impl<'a, 'm, R: BufRead> TokenStream<'a, 'm, R> {
+    pub fn new(tagger: &'a Tagger<'m>, lattice: &'a mut Lattice<'m>, reader: R) -> Self {
+        Self {
+            tagger,
+            lattice,
+            reader,
+            consume: 0,
+            carry: Vec::new(),
+            lines: 0,
+        }
+    }
+
+    /// The number of lines read so far.
+    #[inline]
+    pub fn lines(&self) -> usize {
+        self.lines
+    }
+
+    /// Returns the underlying reader.
+    pub fn into_inner(self) -> R {
+        self.reader
+    }
+
+    /// Reads and parses the next line. Returns `Ok(None)` at the end of the input.
+    ///
+    /// If the line cannot be parsed, it returns an error of [`io::ErrorKind::Other`] containing
+    /// [`Lattice::error()`].
+    pub fn next_sentence(&mut self) -> io::Result<Option<&Lattice<'m>>> {
+        self.reader.consume(std::mem::take(&mut self.consume));
+        self.carry.clear();
+
+        let line = loop {
+            let buf = self.reader.fill_buf()?;
+            if buf.is_empty() {
+                if self.carry.is_empty() {
+                    return Ok(None);
+                }
+                break &self.carry[..];
+            }
+
+            match crate::feat::find_byte(b'\n', buf) {
+                Some(i) if self.carry.is_empty() => {
+                    self.consume = i + 1;
+                    break &buf[..i];
+                }
+                Some(i) => {
+                    self.carry.extend_from_slice(&buf[..i]);
+                    self.reader.consume(i + 1);
+                    break &self.carry[..];
+                }
+                None => {
+                    let n = buf.len();
+                    self.carry.extend_from_slice(buf);
+                    self.reader.consume(n);
+                }
+            }
+        };
+        let line = line.strip_suffix(b"\r").unwrap_or(line);
+        self.lines += 1;
+
+        self.lattice.set_sentence_bytes(line);
+        if !self.tagger.parse(self.lattice) {
+            let e = String::from_utf8_lossy(self.lattice.error()).into_owned();
+            return Err(io::Error::new(io::ErrorKind::Other, e));
+        }
+        Ok(Some(self.lattice))
+    }
+}
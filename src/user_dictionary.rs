@@ -0,0 +1,435 @@
+use crate::ffi::{DictionaryType, Model, OptionKey};
+use crate::FeatureFields;
+
+use libc::c_char;
+
+use std::error::Error;
+use std::ffi::{CString, OsStr};
+use std::fmt;
+use std::fs::{File, OpenOptions};
+use std::io::{self, Write};
+use std::os::unix::ffi::OsStrExt;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+
+#[link(name = "cmecab")]
+extern "C" {
+    fn compile_user_dictionary(
+        dicdir: *const c_char,
+        csv: *const c_char,
+        output: *const c_char,
+        charset: *const c_char,
+    ) -> bool;
+}
+
+/// Kinds of [`EntryError`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum EntryErrorKind {
+    /// Less than 5 fields: surface, left id, right id, cost, and at least one feature.
+    TooFewFields,
+    EmptySurface,
+    /// The left or right id is empty or not a number.
+    InvalidId,
+    /// The left or right id is not less than the number of attributes of the system dictionary.
+    IdOutOfRange,
+    /// The cost is not a number in the range of `i16`.
+    InvalidCost,
+    /// A field contains a control character such as a newline or NUL.
+    ControlCharacter,
+}
+
+/// Invalid entry of a [`UserDictionary`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct EntryError {
+    kind: EntryErrorKind,
+    line: usize,
+}
+
+impl EntryError {
+    #[inline]
+    pub fn kind(&self) -> EntryErrorKind {
+        self.kind
+    }
+
+    /// 1-based index of the entry.
+    #[inline]
+    pub fn line(&self) -> usize {
+        self.line
+    }
+}
+
+impl fmt::Display for EntryError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        let msg = match self.kind {
+            EntryErrorKind::TooFewFields => "too few fields",
+            EntryErrorKind::EmptySurface => "empty surface",
+            EntryErrorKind::InvalidId => "invalid context id",
+            EntryErrorKind::IdOutOfRange => "context id out of range",
+            EntryErrorKind::InvalidCost => "invalid cost",
+            EntryErrorKind::ControlCharacter => "control character in a field",
+        };
+        write!(f, "{msg} at line {}", self.line)
+    }
+}
+
+impl Error for EntryError {}
+
+/// Error of [`UserDictionary::compile()`] and [`UserDictionary::overlay()`].
+#[derive(Debug)]
+pub enum CompileError {
+    Entry(EntryError),
+    /// Failed to write the CSV file or the dictionary.
+    Io(io::Error),
+    /// The model has no system dictionary in a directory.
+    NoSystemDictionary,
+    /// `mecab-dict-index` reported an error.
+    Failed,
+    /// The compiled dictionary cannot be loaded. See [`global_error()`](crate::global_error()).
+    Load,
+}
+
+impl fmt::Display for CompileError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            Self::Entry(e) => e.fmt(f),
+            Self::Io(e) => e.fmt(f),
+            Self::NoSystemDictionary => f.write_str("system dictionary directory not found"),
+            Self::Failed => f.write_str("failed to compile the user dictionary"),
+            Self::Load => f.write_str("failed to load the user dictionary"),
+        }
+    }
+}
+
+impl Error for CompileError {
+    fn source(&self) -> Option<&(dyn Error + 'static)> {
+        match self {
+            Self::Entry(e) => Some(e),
+            Self::Io(e) => Some(e),
+            _ => None,
+        }
+    }
+}
+
+impl From<EntryError> for CompileError {
+    fn from(e: EntryError) -> Self {
+        Self::Entry(e)
+    }
+}
+
+impl From<io::Error> for CompileError {
+    fn from(e: io::Error) -> Self {
+        Self::Io(e)
+    }
+}
+
+/// Entries of a user dictionary, compiled in process.
+///
+/// Each entry is a CSV line of the `mecab-dict-index` format:
+/// `surface,left_id,right_id,cost,feature1,feature2,...`.
+///
+/// `mecab-dict-index` terminates the process on a malformed entry, so the entries are validated
+/// on the Rust side first: [`UserDictionary::from_csv()`] and [`UserDictionary::push()`] check the
+/// syntax, and [`UserDictionary::compile()`] checks the ids against the system dictionary. The ids
+/// must be given: MeCab assigns empty ids from `left-id.def`, `right-id.def` and `rewrite.def`,
+/// and also terminates the process if one of them is missing or no rule matches the features.
+///
+/// [`UserDictionary::overlay()`] compiles the entries and loads a new model with them on top of
+/// the system and user dictionaries of an existing model, in the time it takes to compile the
+/// new entries only. Publish it with [`SharedModel::publish()`](crate::SharedModel::publish()) to
+/// update the dictionary without a restart. The output file is replaced by a rename, so the
+/// published model can be overlaid again with the same path while it is in use.
+///
+/// ```no_run
+/// use mecab_wrapper::{Model, SharedModel, UserDictionary};
+///
+/// # fn test(shared: &SharedModel) -> Result<(), Box<dyn std::error::Error>> {
+/// let mut dic = UserDictionary::new();
+/// dic.push("ほげ言語", 1288, 1288, 3000, "名詞,固有名詞,一般,*,*,*,ほげ言語,ホゲゲンゴ,ホゲゲンゴ")?;
+///
+/// let current = shared.load();
+/// let model = dic.overlay(&current, "/var/lib/app/user.dic")?;
+/// shared.publish(model);
+/// # Ok(())
+/// # }
+/// ```
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct UserDictionary {
+    csv: Vec<u8>,
+    entries: usize,
+}
+
+/// Left and right context ids of an entry.
+type Ids = (u16, u16);
+
+fn validate_line(line: &[u8], n: usize) -> Result<Ids, EntryError> {
+    let err = |kind| EntryError { kind, line: n };
+
+    if line.iter().any(|&b| b < 0x20 && b != b'\t') {
+        return Err(err(EntryErrorKind::ControlCharacter));
+    }
+    let mut fields = FeatureFields::new(line);
+    let surface = fields.next().unwrap_or_default();
+    let (left, right, cost) = match (fields.next(), fields.next(), fields.next()) {
+        (Some(l), Some(r), Some(c)) => (l, r, c),
+        _ => return Err(err(EntryErrorKind::TooFewFields)),
+    };
+    if fields.next().is_none() {
+        return Err(err(EntryErrorKind::TooFewFields));
+    }
+    if surface.is_empty() {
+        return Err(err(EntryErrorKind::EmptySurface));
+    }
+
+    let id = |field: &[u8]| -> Result<u16, EntryError> {
+        std::str::from_utf8(field)
+            .ok()
+            .and_then(|s| s.parse().ok())
+            .ok_or_else(|| err(EntryErrorKind::InvalidId))
+    };
+    let ids = (id(left)?, id(right)?);
+    std::str::from_utf8(cost)
+        .ok()
+        .and_then(|s| s.parse::<i16>().ok())
+        .ok_or_else(|| err(EntryErrorKind::InvalidCost))?;
+    Ok(ids)
+}
+
+/// Quotes `field` as CSV if needed.
+fn push_field(csv: &mut Vec<u8>, field: &[u8]) {
+    if field.iter().any(|&b| b == b',' || b == b'"') {
+        csv.push(b'"');
+        for &b in field {
+            if b == b'"' {
+                csv.push(b'"');
+            }
+            csv.push(b);
+        }
+        csv.push(b'"');
+    } else {
+        csv.extend_from_slice(field);
+    }
+}
+
+fn path_cstring(path: &Path) -> io::Result<CString> {
+    CString::new(path.as_os_str().as_bytes())
+        .map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))
+}
+
+/// Creates a new file next to `path`, named after it with a unique suffix ending in `ext`.
+fn create_unique(path: &Path, ext: &str) -> io::Result<(PathBuf, File)> {
+    static NEXT: AtomicU64 = AtomicU64::new(0);
+    loop {
+        let n = NEXT.fetch_add(1, Ordering::Relaxed);
+        let mut unique = path.as_os_str().to_owned();
+        unique.push(format!(".{}.{n}{ext}", std::process::id()));
+        let unique = PathBuf::from(unique);
+        match OpenOptions::new()
+            .write(true)
+            .create_new(true)
+            .open(&unique)
+        {
+            Ok(file) => return Ok((unique, file)),
+            Err(e) if e.kind() == io::ErrorKind::AlreadyExists => continue,
+            Err(e) => return Err(e),
+        }
+    }
+}
+
+/// Returns true if `a` and `b` name the same file.
+fn same_path(a: &Path, b: &Path) -> bool {
+    match (std::fs::canonicalize(a), std::fs::canonicalize(b)) {
+        (Ok(a), Ok(b)) => a == b,
+        _ => a == b,
+    }
+}
+
+fn run_compiler(
+    dicdir: &Path,
+    csv: &Path,
+    output: &Path,
+    charset: &[u8],
+) -> Result<(), CompileError> {
+    let dicdir = path_cstring(dicdir)?;
+    let csv = path_cstring(csv)?;
+    let output = path_cstring(output)?;
+    let charset = CString::new(charset).unwrap_or_default();
+    let ok = unsafe {
+        compile_user_dictionary(
+            dicdir.as_ptr(),
+            csv.as_ptr(),
+            output.as_ptr(),
+            charset.as_ptr(),
+        )
+    };
+    if ok {
+        Ok(())
+    } else {
+        Err(CompileError::Failed)
+    }
+}
+
+impl UserDictionary {
+    #[inline]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Parses and validates CSV entries, one per line. Empty lines are skipped.
+    pub fn from_csv<T: AsRef<[u8]>>(csv: T) -> Result<Self, EntryError> {
+        let mut dic = Self::new();
+        for (i, line) in csv.as_ref().split(|&b| b == b'\n').enumerate() {
+            let line = line.strip_suffix(b"\r").unwrap_or(line);
+            if line.is_empty() {
+                continue;
+            }
+            validate_line(line, i + 1)?;
+            dic.csv.extend_from_slice(line);
+            dic.csv.push(b'\n');
+            dic.entries += 1;
+        }
+        Ok(dic)
+    }
+
+    /// Adds an entry. `surface` is quoted as needed, while `features` is a comma-separated list
+    /// of already quoted fields.
+    pub fn push(
+        &mut self,
+        surface: &str,
+        left_id: u16,
+        right_id: u16,
+        cost: i16,
+        features: &str,
+    ) -> Result<(), EntryError> {
+        let begin = self.csv.len();
+        push_field(&mut self.csv, surface.as_bytes());
+        let rest = format!(",{left_id},{right_id},{cost},{features}");
+        self.csv.extend_from_slice(rest.as_bytes());
+
+        if let Err(e) = validate_line(&self.csv[begin..], self.entries + 1) {
+            self.csv.truncate(begin);
+            return Err(e);
+        }
+        self.csv.push(b'\n');
+        self.entries += 1;
+        Ok(())
+    }
+
+    /// The number of entries.
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.entries
+    }
+
+    /// Returns true if there are no entries.
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.entries == 0
+    }
+
+    /// The entries as CSV.
+    #[inline]
+    pub fn as_csv(&self) -> &[u8] {
+        &self.csv
+    }
+
+    /// Compiles the entries into a user dictionary file `output` for the system dictionary of
+    /// `model`, the same as `mecab-dict-index -u`.
+    ///
+    /// The dictionary is compiled into a new file next to `output`, which is then renamed to
+    /// `output`. A model mapping the former `output` thus keeps reading the former file. The
+    /// entries are passed to the compiler in a temporary CSV file, also next to `output`, which
+    /// is removed afterwards.
+    ///
+    /// The compiler runs in this process, and like `mecab-dict-index` it writes its progress to
+    /// the standard output of the process.
+    pub fn compile<P: AsRef<Path>>(&self, model: &Model, output: P) -> Result<(), CompileError> {
+        let output = output.as_ref();
+        let info = model.dictionary_info();
+        let dicdir = model
+            .system_dicdir()
+            .ok_or(CompileError::NoSystemDictionary)?;
+
+        for (i, line) in self.csv.split(|&b| b == b'\n').enumerate() {
+            if line.is_empty() {
+                continue;
+            }
+            let err = |kind| EntryError { kind, line: i + 1 };
+            // The left id is an `lattr` and the right id an `rattr`; see `ConnectionMatrix`.
+            let (left, right) = validate_line(line, i + 1)?;
+            if left as u32 >= info.rsize || right as u32 >= info.lsize {
+                return Err(err(EntryErrorKind::IdOutOfRange).into());
+            }
+        }
+
+        let (csv_path, mut csv) = create_unique(output, ".csv")?;
+        let result = csv
+            .write_all(&self.csv)
+            .map_err(CompileError::from)
+            .and_then(|()| {
+                let (dic_path, _) = create_unique(output, ".dic")?;
+                let result = run_compiler(&dicdir, &csv_path, &dic_path, info.charset())
+                    .and_then(|()| Ok(std::fs::rename(&dic_path, output)?));
+                if result.is_err() {
+                    let _ = std::fs::remove_file(&dic_path);
+                }
+                result
+            });
+        let _ = std::fs::remove_file(&csv_path);
+        result
+    }
+
+    /// Compiles the entries into `output` by [`UserDictionary::compile()`], and loads a new model
+    /// with the system dictionary of `model`, its user dictionaries, and `output`.
+    ///
+    /// If `output` is already a user dictionary of `model`, e.g. from a former overlay, the new
+    /// entries replace its entries. Pass a new path to add the entries on top of them instead.
+    ///
+    /// Options of `model` other than the dictionaries are not carried over; to keep them, call
+    /// [`UserDictionary::compile()`] and pass `output` to [`OptionKey::Userdic`] yourself.
+    pub fn overlay<P: AsRef<Path>>(&self, model: &Model, output: P) -> Result<Model, CompileError> {
+        let output = output.as_ref();
+        let dicdir = model
+            .system_dicdir()
+            .ok_or(CompileError::NoSystemDictionary)?;
+        // Resolved before `compile()` replaces `output`.
+        let mut userdic = Vec::new();
+        let mut info = Some(model.dictionary_info());
+        while let Some(dic) = info {
+            let path = Path::new(OsStr::from_bytes(dic.filename()));
+            if dic.dictionary_type() == DictionaryType::User && !same_path(path, output) {
+                userdic.extend_from_slice(dic.filename());
+                userdic.push(b',');
+            }
+            info = dic.next();
+        }
+        userdic.extend_from_slice(output.as_os_str().as_bytes());
+
+        self.compile(model, output)?;
+
+        let userdic =
+            CString::new(userdic).map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?;
+        let args = [
+            (OptionKey::Dicdir, path_cstring(&dicdir)?),
+            (OptionKey::Userdic, userdic),
+        ];
+        Model::new(&args[..]).ok_or(CompileError::Load)
+    }
+}
+
+impl Model {
+    /// Directory of the system dictionary, where `dicrc` and `matrix.bin` are.
+    pub(crate) fn system_dicdir(&self) -> Option<PathBuf> {
+        let mut info = Some(self.dictionary_info());
+        while let Some(dic) = info {
+            if dic.dictionary_type() == DictionaryType::System {
+                let path = Path::new(OsStr::from_bytes(dic.filename()));
+                return path.parent().map(|dir| match dir.as_os_str().is_empty() {
+                    true => PathBuf::from("."),
+                    false => dir.to_path_buf(),
+                });
+            }
+            info = dic.next();
+        }
+        None
+    }
+}
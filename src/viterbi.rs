@@ -0,0 +1,146 @@
+use crate::ffi::{GraphEdge, GraphNode, LatticeGraph};
+
+/// Cost adjustments applied by [`Viterbi::decode()`], added to the costs MeCab computed.
+///
+/// A closure `FnMut(GraphNode<'_>) -> i64` implements `CostHook` as a node adjustment.
+pub trait CostHook {
+    /// Extra cost of passing through `node`. Called once for each reachable node other than BOS.
+    #[inline]
+    fn node(&mut self, node: GraphNode<'_>) -> i64 {
+        let _ = node;
+        0
+    }
+
+    /// Extra cost of the edge from `left` to `right`. Called once for each edge.
+    #[inline]
+    fn edge(&mut self, left: GraphNode<'_>, right: GraphNode<'_>, edge: &GraphEdge) -> i64 {
+        let _ = (left, right, edge);
+        0
+    }
+}
+
+impl<F: FnMut(GraphNode<'_>) -> i64> CostHook for F {
+    #[inline]
+    fn node(&mut self, node: GraphNode<'_>) -> i64 {
+        self(node)
+    }
+}
+
+/// No adjustment: [`Viterbi::decode()`] reproduces the best path of MeCab.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct NoAdjustment;
+
+impl CostHook for NoAdjustment {}
+
+/// Re-decodes the best path of a [`LatticeGraph`] with custom cost adjustments, without parsing
+/// the sentence again.
+///
+/// The edge costs in the graph ([`Path::cost`](crate::Path::cost)) already contain the connection
+/// cost and the word cost of the right node, so the decoder only adds up the costs along the
+/// edges in topological order, which takes time linear in the number of edges. A `Viterbi` keeps
+/// its scratch buffers across calls.
+///
+/// The graph has edges only if the lattice is parsed with
+/// [`MARGINAL_PROB`](crate::RequestType::MARGINAL_PROB) or [`N_BEST`](crate::RequestType::N_BEST).
+///
+/// ```no_run
+/// # use mecab_wrapper::{GraphNode, Lattice, LatticeGraph, RequestType, Tagger, Viterbi};
+/// # fn test(tagger: &Tagger<'_>, lattice: &mut Lattice<'_>) {
+/// lattice.set_request_type(RequestType::MARGINAL_PROB);
+/// lattice.set_sentence("すもももももももものうち");
+/// tagger.parse(lattice);
+///
+/// let mut graph = LatticeGraph::new();
+/// lattice.export_graph(&mut graph, 0.0);
+///
+/// // Penalize the nouns of posid 38.
+/// let mut viterbi = Viterbi::new();
+/// let mut path = Vec::new();
+/// let penalty = |node: GraphNode<'_>| if node.posid() == 38 { 5000 } else { 0 };
+/// let cost = viterbi.decode(&graph, penalty, &mut path);
+///
+/// for &i in &path {
+///     let node = graph.get(i).unwrap();
+///     println!("{:?}", &lattice.sentence()[node.surface_range()]);
+/// }
+/// # }
+/// ```
+#[derive(Debug, Clone, Default)]
+pub struct Viterbi {
+    costs: Vec<i64>,
+    back: Vec<usize>,
+}
+
+const UNREACHABLE: i64 = i64::MAX;
+
+impl Viterbi {
+    #[inline]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Finds the path from BOS to EOS with the least total cost after the adjustments by `hook`,
+    /// and stores the node indices of the path (including BOS and EOS) into `path`, which is
+    /// cleared first.
+    ///
+    /// Returns the total cost, or `None` (and `path` is empty) if `graph` is empty or EOS is not
+    /// reachable, e.g. the edges are filtered out by
+    /// [`Lattice::export_graph()`](crate::Lattice::export_graph()).
+    pub fn decode<H: CostHook>(
+        &mut self,
+        graph: &LatticeGraph,
+        mut hook: H,
+        path: &mut Vec<usize>,
+    ) -> Option<i64> {
+        path.clear();
+        let n = graph.len();
+        if n == 0 {
+            return None;
+        }
+
+        self.costs.clear();
+        self.costs.resize(n, UNREACHABLE);
+        self.back.clear();
+        self.back.resize(n, 0);
+        self.costs[0] = 0;
+
+        for right in graph.nodes().skip(1) {
+            let i = right.index();
+            let mut best = UNREACHABLE;
+            let mut best_left = 0;
+
+            for edge in right.edges() {
+                let l = edge.lnode;
+                if self.costs[l] == UNREACHABLE {
+                    continue;
+                }
+                let left = graph.get(l).unwrap();
+                let cost = self.costs[l] + edge.cost as i64 + hook.edge(left, right, &edge);
+                if cost < best {
+                    best = cost;
+                    best_left = l;
+                }
+            }
+
+            if best != UNREACHABLE {
+                self.costs[i] = best + hook.node(right);
+                self.back[i] = best_left;
+            }
+        }
+
+        let eos = n - 1;
+        let total = self.costs[eos];
+        if total == UNREACHABLE {
+            return None;
+        }
+
+        let mut i = eos;
+        path.push(i);
+        while i != 0 {
+            i = self.back[i];
+            path.push(i);
+        }
+        path.reverse();
+        Some(total)
+    }
+}
@@ -0,0 +1,289 @@
+use crate::ffi::{DictionaryType, Model, ModelArgs};
+use crate::MmapFile;
+
+use std::error::Error;
+use std::ffi::OsStr;
+use std::fmt;
+use std::fs::File;
+use std::io;
+use std::os::unix::ffi::OsStrExt;
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+/// Files in the dictionary directory which MeCab maps but [`DictionaryInfo`](crate::DictionaryInfo)
+/// does not list, with their [`DictionaryFile::dictionary_type`].
+const DICDIR_FILES: [(&str, Option<DictionaryType>); 3] = [
+    ("unk.dic", Some(DictionaryType::UnknownWord)),
+    ("matrix.bin", None),
+    ("char.bin", None),
+];
+
+/// How [`Model::warm_up()`] brings the dictionary files into memory.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum Prefetch {
+    /// Nothing.
+    None,
+    /// `posix_fadvise(POSIX_FADV_WILLNEED)`: the kernel starts reading the files into the page
+    /// cache and the call returns immediately.
+    Advise,
+    /// Maps each file and touches every page, returning after all the pages are in the page
+    /// cache.
+    Populate,
+}
+
+/// Options of [`Model::warm_up()`].
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct WarmupOptions {
+    pub prefetch: Prefetch,
+    /// Prefetches on a new thread instead of the calling thread.
+    pub background: bool,
+    /// Sentences parsed once after prefetching (or while prefetching in the background).
+    pub sentences: Vec<String>,
+}
+
+impl Default for WarmupOptions {
+    fn default() -> Self {
+        Self {
+            prefetch: Prefetch::Advise,
+            background: false,
+            sentences: vec!["すもももももももものうち".to_string()],
+        }
+    }
+}
+
+impl WarmupOptions {
+    /// Sets [`WarmupOptions::prefetch`].
+    #[inline]
+    pub fn prefetch(mut self, prefetch: Prefetch) -> Self {
+        self.prefetch = prefetch;
+        self
+    }
+
+    /// Sets [`WarmupOptions::background`].
+    #[inline]
+    pub fn background(mut self, background: bool) -> Self {
+        self.background = background;
+        self
+    }
+
+    /// Replaces [`WarmupOptions::sentences`].
+    pub fn sentences<I, S>(mut self, sentences: I) -> Self
+    where
+        I: IntoIterator<Item = S>,
+        S: Into<String>,
+    {
+        self.sentences = sentences.into_iter().map(Into::into).collect();
+        self
+    }
+}
+
+/// A file loaded by a [`Model`], returned by [`Model::dictionary_files()`].
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct DictionaryFile {
+    pub path: PathBuf,
+    /// Size in bytes.
+    pub size: u64,
+    /// `None` for the files in the dictionary directory which are not dictionaries themselves
+    /// (`matrix.bin` and `char.bin`).
+    pub dictionary_type: Option<DictionaryType>,
+}
+
+/// A file [`Model::warm_up()`] could not prefetch.
+#[derive(Debug)]
+pub struct PrefetchError {
+    pub path: PathBuf,
+    pub error: io::Error,
+}
+
+impl fmt::Display for PrefetchError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "cannot prefetch {}: {}", self.path.display(), self.error)
+    }
+}
+
+impl Error for PrefetchError {
+    fn source(&self) -> Option<&(dyn Error + 'static)> {
+        Some(&self.error)
+    }
+}
+
+/// What [`Model::warm_up()`] did.
+#[derive(Debug)]
+pub struct WarmupReport {
+    pub files: Vec<DictionaryFile>,
+    /// The number of warmup sentences parsed successfully.
+    pub parsed: usize,
+    /// Time spent on the calling thread.
+    pub elapsed: Duration,
+    /// The files which could not be prefetched on the calling thread.
+    pub errors: Vec<PrefetchError>,
+    background: Option<JoinHandle<Vec<PrefetchError>>>,
+}
+
+impl WarmupReport {
+    /// Total size of [`WarmupReport::files`].
+    pub fn total_size(&self) -> u64 {
+        self.files.iter().map(|f| f.size).sum()
+    }
+
+    /// Waits for the background prefetch, if any, and returns all the files which could not be
+    /// prefetched, including [`WarmupReport::errors`].
+    pub fn join(self) -> Vec<PrefetchError> {
+        let mut errors = self.errors;
+        if let Some(handle) = self.background {
+            match handle.join() {
+                Ok(background) => errors.extend(background),
+                Err(_) => errors.push(PrefetchError {
+                    path: PathBuf::new(),
+                    error: io::Error::new(io::ErrorKind::Other, "prefetch panicked"),
+                }),
+            }
+        }
+        errors
+    }
+}
+
+fn prefetch_file(path: &Path, prefetch: Prefetch) -> io::Result<()> {
+    match prefetch {
+        Prefetch::None => {}
+        Prefetch::Advise => {
+            let file = File::open(path)?;
+            unsafe {
+                libc::posix_fadvise(file.as_raw_fd(), 0, 0, libc::POSIX_FADV_WILLNEED);
+            }
+        }
+        Prefetch::Populate => {
+            let map = MmapFile::open(path)?;
+            let page = unsafe { libc::sysconf(libc::_SC_PAGESIZE) }.max(1) as usize;
+            let mut sum = 0u8;
+            for i in (0..map.len()).step_by(page) {
+                sum = sum.wrapping_add(unsafe { std::ptr::read_volatile(&map[i]) });
+            }
+            std::hint::black_box(sum);
+        }
+    }
+    Ok(())
+}
+
+/// Prefetches every file of `paths`, going on after a failure.
+fn prefetch_files(paths: &[PathBuf], prefetch: Prefetch) -> Vec<PrefetchError> {
+    paths
+        .iter()
+        .filter_map(|path| {
+            let error = prefetch_file(path, prefetch).err()?;
+            Some(PrefetchError {
+                path: path.clone(),
+                error,
+            })
+        })
+        .collect()
+}
+
+impl Model {
+    /// Creates a model by [`Model::new()`] and warms it up by [`Model::warm_up()`].
+    pub fn with_warmup<A: ModelArgs>(
+        args: A,
+        options: &WarmupOptions,
+    ) -> Option<(Self, WarmupReport)> {
+        let model = Self::new(args)?;
+        let report = model.warm_up(options);
+        Some((model, report))
+    }
+
+    /// Files loaded by `self`: the dictionaries listed by [`Model::dictionary_info()`], and
+    /// `unk.dic`, `matrix.bin` and `char.bin` next to the system dictionary. Files which cannot
+    /// be found are left out.
+    pub fn dictionary_files(&self) -> Vec<DictionaryFile> {
+        let mut files = Vec::new();
+        let mut dicdir = None;
+
+        let mut info = Some(self.dictionary_info());
+        while let Some(dic) = info {
+            let path = Path::new(OsStr::from_bytes(dic.filename()));
+            let ty = dic.dictionary_type();
+            if ty == DictionaryType::System && dicdir.is_none() {
+                dicdir = path.parent().map(Path::to_path_buf);
+            }
+            if let Ok(meta) = path.metadata() {
+                files.push(DictionaryFile {
+                    path: path.to_path_buf(),
+                    size: meta.len(),
+                    dictionary_type: Some(ty),
+                });
+            }
+            info = dic.next();
+        }
+
+        if let Some(dicdir) = dicdir {
+            for (name, dictionary_type) in DICDIR_FILES {
+                let path = dicdir.join(name);
+                if let Ok(meta) = path.metadata() {
+                    files.push(DictionaryFile {
+                        path,
+                        size: meta.len(),
+                        dictionary_type,
+                    });
+                }
+            }
+        }
+        files
+    }
+
+    /// Brings the dictionary files into memory and parses some sentences, so that the first
+    /// requests do not pay for page faults on the mmapped dictionaries.
+    ///
+    /// MeCab maps the dictionaries lazily, and each page is read from the disk on first access.
+    /// The files are read ahead into the page cache as `options.prefetch` specifies, then
+    /// `options.sentences` are parsed once. A file which cannot be prefetched does not stop the
+    /// others; it is reported in [`WarmupReport::errors`], or by [`WarmupReport::join()`] for a
+    /// background prefetch.
+    ///
+    /// ```no_run
+    /// use mecab_wrapper::{Model, Prefetch, WarmupOptions};
+    ///
+    /// let options = WarmupOptions::default()
+    ///     .prefetch(Prefetch::Populate)
+    ///     .background(true);
+    /// let (model, report) = Model::with_warmup("", &options).unwrap();
+    /// for file in &report.files {
+    ///     println!("{} {} bytes", file.path.display(), file.size);
+    /// }
+    /// for error in report.join() {
+    ///     eprintln!("{error}");
+    /// }
+    /// ```
+    pub fn warm_up(&self, options: &WarmupOptions) -> WarmupReport {
+        let start = Instant::now();
+        let files = self.dictionary_files();
+        let paths: Vec<PathBuf> = files.iter().map(|f| f.path.clone()).collect();
+        let prefetch = options.prefetch;
+
+        let (errors, background) = if options.background && prefetch != Prefetch::None {
+            let handle = std::thread::spawn(move || prefetch_files(&paths, prefetch));
+            (Vec::new(), Some(handle))
+        } else {
+            (prefetch_files(&paths, prefetch), None)
+        };
+
+        let mut parsed = 0;
+        if let Some(tagger) = self.create_tagger() {
+            let mut lattice = self.create_lattice();
+            for sentence in &options.sentences {
+                lattice.set_sentence(sentence);
+                if tagger.parse(&mut lattice) {
+                    parsed += 1;
+                }
+            }
+        }
+
+        WarmupReport {
+            files,
+            parsed,
+            elapsed: start.elapsed(),
+            errors,
+            background,
+        }
+    }
+}